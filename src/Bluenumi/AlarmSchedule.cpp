@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+extern "C" {
+  #include <inttypes.h>
+}
+
+#include "AlarmSchedule.h"
+
+AlarmSchedule::AlarmSchedule()
+{
+  // The buttons set the first slot, which goes off every day; the others
+  // start out with no days
+  for (uint8_t i = 0; i < MAX_ALARMS; i++)
+  {
+    alarms[i].hour = 0;
+    alarms[i].minute = 0;
+    alarms[i].days = i == 0 ? ALARM_EVERY_DAY : 0;
+    alarms[i].flags = 0;
+  }
+
+  nextFire = NO_ALARM;
+  nextAlarm = 0;
+  lastChecked = NO_ALARM;
+  stale = true;
+  recomputes = 0;
+}
+
+/**
+ * Takes the alarms from the settings store, which must have been loaded.
+ */
+void AlarmSchedule::load()
+{
+  for (uint8_t i = 0; i < MAX_ALARMS; i++)
+  {
+    alarms[i].hour = Settings.get(alarmSetting(i, SETTING_ALARM_HOUR));
+    alarms[i].minute = Settings.get(alarmSetting(i, SETTING_ALARM_MINUTE));
+    alarms[i].days = Settings.get(alarmSetting(i, SETTING_ALARM_DAYS));
+    alarms[i].flags = Settings.get(alarmSetting(i, SETTING_ALARM_FLAGS));
+  }
+
+  stale = true;
+}
+
+/**
+ * Hands every alarm to the settings store.
+ */
+void AlarmSchedule::save()
+{
+  for (uint8_t i = 0; i < MAX_ALARMS; i++)
+    store(i);
+}
+
+const Alarm *AlarmSchedule::get(uint8_t index)
+{
+  return &alarms[index];
+}
+
+/**
+ * Replaces an alarm and saves it. The caller checks it with isValid().
+ */
+void AlarmSchedule::set(uint8_t index, const Alarm *alarm)
+{
+  alarms[index] = *alarm;
+  store(index);
+  stale = true;
+}
+
+bool AlarmSchedule::isEnabled(uint8_t index)
+{
+  return (alarms[index].flags & ALARM_ENABLED) && alarms[index].days;
+}
+
+bool AlarmSchedule::anyEnabled()
+{
+  for (uint8_t i = 0; i < MAX_ALARMS; i++)
+  {
+    if (isEnabled(i))
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * Call with the current minute of the week at least once a minute. Returns
+ * true once when an alarm is due, disabling any one-shot alarms set for
+ * this minute.
+ */
+bool AlarmSchedule::check(uint16_t now)
+{
+  // Anything but the same or the following minute means the time was set
+  if (stale || (now != lastChecked && now != (lastChecked + 1) % MINUTES_PER_WEEK))
+    recompute(now);
+
+  lastChecked = now;
+
+  if (now != nextFire)
+    return false;
+
+  for (uint8_t i = 0; i < MAX_ALARMS; i++)
+  {
+    const Alarm &alarm = alarms[i];
+    uint16_t time = alarm.hour * 60 + alarm.minute;
+
+    if ((alarm.flags & ALARM_ONE_SHOT) && isEnabled(i) &&
+        time == now % MINUTES_PER_DAY && (alarm.days & _BV(now / MINUTES_PER_DAY)))
+    {
+      alarms[i].flags &= ~ALARM_ENABLED;
+      store(i);
+    }
+  }
+
+  recompute((now + 1) % MINUTES_PER_WEEK);
+
+  return true;
+}
+
+uint16_t AlarmSchedule::getNextFire()
+{
+  return nextFire;
+}
+
+uint8_t AlarmSchedule::getNextAlarm()
+{
+  return nextAlarm;
+}
+
+uint16_t AlarmSchedule::getRecomputes()
+{
+  return recomputes;
+}
+
+bool AlarmSchedule::isValid(const Alarm *alarm)
+{
+  return alarm->hour < 24 && alarm->minute < 60 && alarm->days <= ALARM_EVERY_DAY &&
+      alarm->flags <= (ALARM_ENABLED | ALARM_ONE_SHOT);
+}
+
+/**
+ * Counts minutes from midnight at the start of day 1. A day of 0, which
+ * the DS1307 never keeps, counts as day 7.
+ */
+uint16_t AlarmSchedule::minuteOfWeek(uint8_t dayOfWeek, uint8_t hour, uint8_t minute)
+{
+  return ((dayOfWeek + 6) % 7) * MINUTES_PER_DAY + hour * 60 + minute;
+}
+
+/**
+ * Finds the first alarm due at or after from, wrapping round the week.
+ */
+void AlarmSchedule::recompute(uint16_t from)
+{
+  uint16_t soonest = NO_ALARM;
+
+  for (uint8_t i = 0; i < MAX_ALARMS; i++)
+  {
+    if (!isEnabled(i))
+      continue;
+
+    for (uint8_t day = 0; day < 7; day++)
+    {
+      if (!(alarms[i].days & _BV(day)))
+        continue;
+
+      uint16_t time = day * MINUTES_PER_DAY + alarms[i].hour * 60 + alarms[i].minute;
+      uint16_t wait = (time + MINUTES_PER_WEEK - from) % MINUTES_PER_WEEK;
+
+      if (wait < soonest)
+      {
+        soonest = wait;
+        nextAlarm = i;
+      }
+    }
+  }
+
+  nextFire = soonest == NO_ALARM ? NO_ALARM : (from + soonest) % MINUTES_PER_WEEK;
+  stale = false;
+  recomputes++;
+}
+
+void AlarmSchedule::store(uint8_t index)
+{
+  Settings.set(alarmSetting(index, SETTING_ALARM_HOUR), alarms[index].hour);
+  Settings.set(alarmSetting(index, SETTING_ALARM_MINUTE), alarms[index].minute);
+  Settings.set(alarmSetting(index, SETTING_ALARM_DAYS), alarms[index].days);
+  Settings.set(alarmSetting(index, SETTING_ALARM_FLAGS), alarms[index].flags);
+}
+
+AlarmSchedule Alarms = AlarmSchedule();
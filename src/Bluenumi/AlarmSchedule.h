@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef ALARMSCHEDULE_H_
+#define ALARMSCHEDULE_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "Settings.h"
+
+#define MAX_ALARMS SETTINGS_ALARMS
+
+// Alarm days: bit n is set for day of week n + 1, as kept by the DS1307
+#define ALARM_EVERY_DAY 0x7F
+
+// Alarm flags
+#define ALARM_ENABLED 0x01
+#define ALARM_ONE_SHOT 0x02 // Disables itself after going off
+
+#define MINUTES_PER_DAY 1440
+#define MINUTES_PER_WEEK 10080
+#define NO_ALARM 0xFFFF
+
+/**
+ * One alarm slot. hour is on the 24 hour clock.
+ */
+struct Alarm
+{
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t days;
+  uint8_t flags;
+};
+
+/**
+ * Up to MAX_ALARMS alarms, each on any set of weekdays, kept in the
+ * settings store. Instead of testing every alarm on every tick, the
+ * schedule keeps the minute of the week at which the next one goes off,
+ * and check() compares the time against just that. The next alarm is only
+ * worked out again when an alarm changes, when one has gone off, or when
+ * the time jumps, as when it is set.
+ */
+class AlarmSchedule
+{
+  public:
+    AlarmSchedule();
+    void load();
+    void save();
+    const Alarm *get(uint8_t);
+    void set(uint8_t, const Alarm*);
+    bool isEnabled(uint8_t);
+    bool anyEnabled();
+    bool check(uint16_t);
+    uint16_t getNextFire();
+    uint8_t getNextAlarm();
+    uint16_t getRecomputes();
+    static bool isValid(const Alarm*);
+    static uint16_t minuteOfWeek(uint8_t, uint8_t, uint8_t);
+
+  private:
+    Alarm alarms[MAX_ALARMS];
+    uint16_t nextFire; // Minute of the week, or NO_ALARM
+    uint8_t nextAlarm;
+    uint16_t lastChecked; // Minute of the week of the last check()
+    bool stale; // An alarm changed since nextFire was worked out
+    uint16_t recomputes;
+    void recompute(uint16_t);
+    void store(uint8_t);
+};
+
+extern AlarmSchedule Alarms;
+
+#endif // ALARMSCHEDULE_H_
@@ -15,71 +15,147 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
 
+#include <avr/interrupt.h>
 #include "AudioController.h"
-#include "Display.h"
-#include "LEDController.h"
+#include "IsrProfiler.h"
 
 AudioController::AudioController()
 {
+  playing = false;
+}
+
+void AudioController::begin()
+{
+  pinMode(PIEZO_PIN, OUTPUT);
 }
 
 void AudioController::singleBeep()
 {
-  disableDisplays();
-  playNote(NOTE_BEEP, DUR_ET);
-  enableDisplays();
+  play(&SINGLE_BEEP_MELODY);
 }
 
 void AudioController::doubleBeep()
 {
-  disableDisplays();
-  playNote(NOTE_BEEP, DUR_ET);
-  delay(DUR_ET);
-  playNote(NOTE_BEEP, DUR_ET);
-  enableDisplays();
+  play(&DOUBLE_BEEP_MELODY);
 }
 
-void AudioController::playMelody(Melody *melody)
+void AudioController::play(const Melody *melody)
 {
-  disableDisplays();
+  start((const uint8_t*) pgm_read_ptr(&melody->data), pgm_read_word(&melody->size), true, 1);
+}
 
-  for (int i = 0; i < melody->length; i++)
-  {
-    playNote(melody->notes[i], melody->durations[i]);
-  }
+void AudioController::playReverse(const Melody *melody)
+{
+  start((const uint8_t*) pgm_read_ptr(&melody->data), pgm_read_word(&melody->size), true, -1);
+}
+
+/**
+ * Plays a packed melody from RAM, such as one loaded from the DS1307. The
+ * data must stay put until the melody ends.
+ */
+void AudioController::play(const uint8_t *data, uint16_t size)
+{
+  start(data, size, false, 1);
+}
+
+void AudioController::stop()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  playing = false;
+  noTone(PIEZO_PIN);
+  TIMSK0 &= ~_BV(OCIE0A);
+  SREG = oldSREG;
+}
 
-  enableDisplays();
+bool AudioController::isPlaying()
+{
+  return playing;
 }
 
-void AudioController::playMelodyBackwards(Melody *melody)
+/**
+ * Called from the timer interrupt every SEQUENCER_TICK_MICROS.
+ */
+void AudioController::tick()
 {
-  disableDisplays();
+  if (!playing)
+    return;
 
-  for (int i = melody->length - 1; i >= 0; i--)
+  if (noteRemaining > SEQUENCER_TICK_MICROS)
   {
-    playNote(melody->notes[i], melody->durations[i]);
+    noteRemaining -= SEQUENCER_TICK_MICROS;
+    return;
   }
 
-  enableDisplays();
+  nextNote();
 }
 
-inline void AudioController::playNote(uint16_t note, uint16_t duration)
+/**
+ * Starts at the first byte of data, or the last when step is -1.
+ */
+void AudioController::start(const uint8_t *data, uint16_t size, bool inFlash, int8_t step)
 {
-  tone(PIEZO_PIN, note);
-  delay(duration);
-  noTone(PIEZO_PIN);
+  uint8_t oldSREG = SREG;
+  cli();
+  this->data = data;
+  this->size = size;
+  this->inFlash = inFlash;
+  position = step > 0 ? 0 : size - 1;
+  this->step = step;
+  playing = true;
+  nextNote();
+
+  // Timer0 already runs for millis(); its compare A match fires once per
+  // period whatever OCR0A holds, so this doesn't disturb PWM on pin 6
+  if (playing)
+    TIMSK0 |= _BV(OCIE0A);
+
+  SREG = oldSREG;
 }
 
-inline void AudioController::disableDisplays()
+/**
+ * Streams the melody up to its next note and starts it, or silences the
+ * piezo once the melody has run off either end. Must be called with
+ * interrupts disabled.
+ */
+void AudioController::nextNote()
 {
-  Display.setEnabled(false);
-  LEDs.setEnabled(false);
+  for (;;)
+  {
+    if (position < 0 || position >= (int16_t) size)
+    {
+      noTone(PIEZO_PIN);
+      TIMSK0 &= ~_BV(OCIE0A);
+      playing = false;
+      return;
+    }
+
+    uint8_t code = inFlash ? pgm_read_byte(data + position) : data[position];
+    position += step;
+
+    if (!(code & MELODY_DURATION_FLAG))
+    {
+      uint16_t frequency = noteFrequency(code);
+
+      if (frequency == NOTE_RST)
+        noTone(PIEZO_PIN);
+      else
+        tone(PIEZO_PIN, frequency);
+
+      noteRemaining = (uint32_t) durationMillis(duration) * 1000;
+      return;
+    }
+
+    // Playing backward, a duration change undoes itself
+    duration = step > 0 ? code : code >> 3;
+  }
 }
 
-inline void AudioController::enableDisplays()
+ISR(TIMER0_COMPA_vect)
 {
-  Display.setEnabled(true);
-  LEDs.setEnabled(true);
+  uint16_t start = Profiler.enter(ISR_TIMER0_COMPA);
+  Audio.tick();
+  Profiler.exit(ISR_TIMER0_COMPA, start);
 }
 
 AudioController Audio = AudioController();
@@ -24,20 +24,41 @@
 
 #define PIEZO_PIN 8
 
+// The sequencer is advanced from the Timer0 compare A interrupt, which fires
+// once per Timer0 period (64 * 256 cycles at 16 MHz)
+#define SEQUENCER_TICK_MICROS 1024
+
+/**
+ * Plays melodies in the background. play() and playReverse() return
+ * immediately; the timer interrupt streams the packed melody out of flash
+ * (or RAM) a note at a time and silences the piezo at the end. Starting a new
+ * melody replaces the one playing.
+ */
 class AudioController
 {
   public:
     AudioController();
+    void begin();
     void singleBeep();
     void doubleBeep();
-    void playMelody(Melody*);
-    void playMelodyBackwards(Melody*);
+    void play(const Melody*);
+    void playReverse(const Melody*);
+    void play(const uint8_t*, uint16_t);
+    void stop();
+    bool isPlaying();
+    void tick();
 
   private:
-    inline void playNote(uint16_t, uint16_t);
-    inline void disableDisplays();
-    inline void enableDisplays();
-    void outputTone(int, int);
+    volatile bool playing;
+    const uint8_t *data;
+    uint16_t size;
+    bool inFlash;
+    volatile int16_t position; // Next byte of data
+    volatile int8_t step;
+    uint8_t duration; // Duration code of the next note
+    volatile uint32_t noteRemaining;
+    void start(const uint8_t*, uint16_t, bool, int8_t);
+    void nextNote();
 };
 
 extern AudioController Audio;
@@ -19,9 +19,10 @@
 #define BLUENUMI_H_
 
 #include <Arduino.h>
+#include <avr/pgmspace.h>
 
 #define NUM_RUN_MODES 5
-#define NUM_SET_MODES 7
+#define NUM_SET_MODES 8
 
 enum RunMode 
 {
@@ -40,11 +41,83 @@ enum SetMode
   HR_ONES,
   MIN_TENS,
   MIN_ONES,
-  AMPM
+  AMPM,
+  DAY_OF_WEEK
 };
 
 typedef void (*ModeHandler)();
 typedef void (*CycleHandler)();
 typedef void (*ButtonHandler)(boolean);
 
+// Set modes skipped when setting the alarm, or in 24 hour mode
+#define SET_MODE_TIME_ONLY 0x01
+#define SET_MODE_TWELVE_HOUR_ONLY 0x02
+
+#define DISPATCH_MEASURE_COUNT 64 // Dispatches to average over
+
+/**
+ * One row of the run mode table, which lives in flash. handler runs from the
+ * mode task, the button handlers get the presses made in this mode, and a
+ * dual press switches to dualButton (or does nothing if that is this mode).
+ * exit runs when leaving the mode, before the next mode's enter.
+ */
+struct RunModeState
+{
+  uint8_t mode; // The RunMode this row is for
+  ModeHandler handler;
+  ButtonHandler timeButton;
+  ButtonHandler alarmButton;
+  uint8_t dualButton;
+  ModeHandler enter;
+  ModeHandler exit;
+};
+
+/**
+ * One row of the set mode table, which lives in flash. handler draws the
+ * sub-mode, cycle advances its value, and the alarm button moves on to next,
+ * skipping rows whose flags rule them out.
+ */
+struct SetModeState
+{
+  uint8_t mode; // The SetMode this row is for
+  ModeHandler handler;
+  CycleHandler cycle;
+  uint8_t next;
+  uint8_t flags;
+};
+
+/**
+ * Compile time checks for the tables: every row is in enum order and has
+ * all its handlers, and (for set modes) following next from NONE visits
+ * every sub-mode once before coming back.
+ */
+constexpr bool runModesValid(const RunModeState *table, uint8_t i)
+{
+  return i == NUM_RUN_MODES ||
+      (table[i].mode == i &&
+       table[i].handler != NULL &&
+       table[i].timeButton != NULL &&
+       table[i].alarmButton != NULL &&
+       table[i].dualButton < NUM_RUN_MODES &&
+       table[i].enter != NULL &&
+       table[i].exit != NULL &&
+       runModesValid(table, i + 1));
+}
+
+constexpr bool setModesValid(const SetModeState *table, uint8_t i)
+{
+  return i == NUM_SET_MODES ||
+      (table[i].mode == i &&
+       table[i].handler != NULL &&
+       table[i].cycle != NULL &&
+       table[i].next < NUM_SET_MODES &&
+       setModesValid(table, i + 1));
+}
+
+constexpr uint8_t setModeCycleLength(const SetModeState *table, uint8_t mode, uint8_t length)
+{
+  return (mode == NONE || length > NUM_SET_MODES) ?
+      length : setModeCycleLength(table, table[mode].next, length + 1);
+}
+
 #endif
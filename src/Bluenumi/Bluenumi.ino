@@ -16,13 +16,24 @@
  ******************************************************************************/
 
 #include <avr/interrupt.h> // Used for adding interrupts
-#include "Wire.h" // Used for communicating over I2C
+#include "I2CBus.h" // Interrupt driven I2C
 #include "DS1307RTC.h" // Library for RTC tasks
+#include "SoftClock.h" // Local time kept from the RTC square wave
 #include "Bluenumi.h" // Locally-used data types
 #include "Display.h" // Numitron display control
 #include "LEDController.h" // Underlighting control
 #include "AudioController.h" // Piezo buzzer control
-#include "Bounce.h" // Button debouncing
+#include "PortDebouncer.h" // Button debouncing
+#include "EventQueue.h" // Events from the pin change interrupt
+#include "Scheduler.h" // Cooperative task scheduling
+#include "MelodyUpload.h" // Custom alarm melody over serial
+#include "Settings.h" // Settings kept in DS1307 RAM
+#include "AlarmSchedule.h" // Weekly alarms and the next one due
+#include "IdleManager.h" // Sleep between tasks
+#include "FastPin.h" // Pin access resolved at compile time
+#include "IsrProfiler.h" // Interrupt handler timing
+#include "InputRecorder.h" // Button trace for replay in the simulator
+#include "Telemetry.h" // Runtime statistics kept across a reset
 
 /*******************************************************************************
  *
@@ -40,7 +51,6 @@
  * Misc Defines
  *
  ******************************************************************************/
-#define DEBOUNCE_INTERVAL 20 // Interval to wait when debouncing buttons
 #define LONG_PRESS 2000 // Length of time that qualifies as a long button press
 #define BLINK_DELAY 500 // Length of display blink on/off interval
 
@@ -49,6 +59,35 @@
 #define ALARM_SHOW_INTERVAL 2000 // Length of time to flash alarm time when
                                  // enabling the alarm
 
+// Default night brightness profile, used until a night record is uploaded
+// (see MelodyUpload.h). It leaves the tubes at full brightness, so nothing
+// dims until a profile with a lower level is stored.
+#define NIGHT_START_HOUR 22 // 24 hour clock
+#define NIGHT_END_HOUR 7
+#define NIGHT_BRIGHTNESS DISPLAY_BRIGHTNESS_LEVELS // Out of DISPLAY_BRIGHTNESS_LEVELS
+
+/*******************************************************************************
+ *
+ * Task Timing (all in ms)
+ *
+ ******************************************************************************/
+#define BUTTON_TASK_PERIOD 5 // Drains ISR events and samples buttons; four
+                             // samples debounce a press
+#define BUTTON_TASK_DEADLINE 10
+#define MODE_TASK_PERIOD 10 // Display refresh through the run mode handlers
+#define MODE_TASK_DEADLINE 20
+#define I2C_TASK_PERIOD 5 // Reports finished I2C transfers, catches a stuck bus,
+                        // writes back settings
+#define I2C_TASK_DEADLINE 20
+#define CLOCK_TASK_PERIOD 100 // Folds RTC ticks into the local time
+#define CLOCK_TASK_DEADLINE 500
+#define LED_TASK_PERIOD LED_FRAME_PERIOD // LED animation
+#define LED_TASK_DEADLINE (2 * LED_FRAME_PERIOD)
+#define ALARM_TASK_DEADLINE 100 // Alarm check after each time fetch
+#define ALARM_SHOW_TASK_DEADLINE 50 // End of the alarm time display
+#define UPLOAD_TASK_INTERVAL 20 // Drains the serial buffer during an upload
+#define UPLOAD_TASK_DEADLINE 30
+
 /*******************************************************************************
  *
  * Debug Defines
@@ -67,22 +106,39 @@ byte timeSetMinutes = 0;
 boolean timeSetTwelveHourMode = true;
 boolean timeSetAmPm = false;
 
-byte alarmHours = 12; 
-byte alarmMinutes = 0;
-boolean alarmAmPm = false;
-boolean alarmEnabled = false;
-boolean alarmRecentlySnuffed = false;
+byte timeSetDayOfWeek = 1;
+
+// Minute of the week the ringing alarm went off
+uint16_t alarmRingingMinute = NO_ALARM;
+
 
 boolean skipNextBlink = false;
 
-Bounce timeSetButtonDebouncer = Bounce(TIME_BTN_PIN, DEBOUNCE_INTERVAL);
-Bounce alarmSetButtonDebouncer = Bounce(ALRM_BTN_PIN, DEBOUNCE_INTERVAL);
+// True while the alarm time is shown after enabling the alarm
+boolean alarmShowing = false;
+
+// Last time read from the RTC, checked against the alarm by the alarm task
+byte currentHours = 0;
+byte currentMinutes = 0;
+boolean currentAmPm = false;
+boolean currentTwelveHourMode = true;
+
+// Scheduler task ids
+uint8_t buttonTask = NO_TASK;
+uint8_t i2cTask = NO_TASK;
+uint8_t clockTask = NO_TASK;
+uint8_t modeTask = NO_TASK;
+uint8_t ledTask = NO_TASK;
+uint8_t alarmTask = NO_TASK;
+uint8_t alarmShowTask = NO_TASK;
+uint8_t uploadTask = NO_TASK;
+
 
 // Timer to track temporary display unblanking when in run blank mode
 unsigned long unblankTime = 0;
 
 // Set to true when time display needs updating
-volatile boolean displayDirty = true; 
+boolean displayDirty = true; 
 
 // Keeps track of current run mode (RUN, SET_TIME, etc.)
 enum RunMode currentRunMode = RUN;
@@ -91,19 +147,19 @@ enum RunMode currentRunMode = RUN;
 enum SetMode currentSetMode = NONE;
 
 // Keeps track of when time (left) button was pressed, mostly used to detect
-// long presses (this value is set during an interrupt)
-volatile unsigned long timeSetButtonPressTime = 0;
+// long presses (micros() timestamp of the interrupt that saw it)
+unsigned long timeSetButtonPressTime = 0;
+boolean timeSetButtonDown = false;
+boolean timeSetButtonPending = false; // Press not yet handled
 
 // Keeps track of when alarm (right) button was pressed, mostly used to detect
-// long presses (this value is set during an interrupt)
-volatile unsigned long alarmSetButtonPressTime = 0; 
+// long presses (micros() timestamp of the interrupt that saw it)
+unsigned long alarmSetButtonPressTime = 0; 
+boolean alarmSetButtonDown = false;
+boolean alarmSetButtonPending = false; // Press not yet handled
 
-// Function pointers for state machine handler functions
-ModeHandler runModeHandlerMap[NUM_RUN_MODES] = {NULL};
-ModeHandler setModeHandlerMap[NUM_SET_MODES] = {NULL};
-ButtonHandler timeButtonHandlerMap[NUM_RUN_MODES] = {NULL};
-ButtonHandler alarmButtonHandlerMap[NUM_RUN_MODES] = {NULL};
-CycleHandler setModeCycleHandlerMap[NUM_SET_MODES] = {NULL};
+// Both buttons were pressed together
+boolean dualButtonPending = false;
 
 /*******************************************************************************
  *
@@ -113,6 +169,11 @@ CycleHandler setModeCycleHandlerMap[NUM_SET_MODES] = {NULL};
 
 void setup()
 {
+#if INPUT_TRACE
+  // Print the session recorded before the last reset
+  Recorder.dump();
+#endif
+
 #if DEBUG
 Serial.begin(DEBUG_BAUD);
 Serial.println("Bluenumi");
@@ -127,31 +188,91 @@ Serial.println("Firmware Version 001");
   pinMode(ALRM_BTN_PIN, INPUT);
  
   // Pull-up resistors for buttons and DS1307 square wave
-  digitalWrite(HZ_PIN, HIGH);
-  digitalWrite(TIME_BTN_PIN, HIGH);
-  digitalWrite(ALRM_BTN_PIN, HIGH);
+  FastPin<HZ_PIN>::high();
+  FastPin<TIME_BTN_PIN>::high();
+  FastPin<ALRM_BTN_PIN>::high();
   
   // The Arduino libraries do not support enough interrupts, so here we use
-  // standard AVR libc interrupt vectors for the two buttons, and the RTC
-  // square wave
+  // standard AVR libc interrupt vectors for the RTC square wave. The buttons
+  // are sampled by the button task instead.
   PCICR |= (1 << PCIE2);
-  PCMSK2 |= (1 << PCINT18); // Alarm button
   PCMSK2 |= (1 << PCINT20); // RTC square wave
-  PCMSK2 |= (1 << PCINT19); // Time button
+
+  // Buttons pull their pins low when pressed
+  Buttons.begin(_BV(TIME_BTN_PIN) | _BV(ALRM_BTN_PIN));
+
+#if INPUT_TRACE
+  // Recording enables the buttons' pin change interrupts for good, which
+  // also lets them wake the clock from power-down
+  Recorder.begin(_BV(TIME_BTN_PIN) | _BV(ALRM_BTN_PIN));
+  Idle.begin(0);
+#else
+  // Only the square wave interrupt is enabled for the buttons' pins, so they
+  // have to be added to wake the clock from power-down
+  Idle.begin(_BV(TIME_BTN_PIN) | _BV(ALRM_BTN_PIN));
+#endif
+
+  // Holding the time button at power-up sends the telemetry kept from
+  // before the reset over the indicator LED pins
+  if (!FastPin<TIME_BTN_PIN>::read())
+  {
+    Telemetry.send();
+#if DEBUG
+Serial.begin(DEBUG_BAUD);
+#endif
+  }
+
+  // Paints the free RAM, so the stack has to be shallow
+  Telemetry.begin();
+
+  // Holding the alarm button at power-up lends the indicator LED pins to
+  // the serial port for a custom alarm melody upload
+  if (!FastPin<ALRM_BTN_PIN>::read())
+    Uploader.beginUpload();
 
   // Start 2-wire communication with DS1307
   DS1307RTC.begin();
 
+#if INPUT_TRACE
+  Recorder.saveRegisters();
+#endif
+
   // Start numitron display
   Display.begin();
 
+#if DEBUG
+Display.setBackend(SegmentDisplay::SHIFT_OUT);
+Serial.print("Frame cycles (shiftOut): ");
+Serial.println(Display.measureFrameCycles());
+Display.setBackend(SegmentDisplay::DIRECT_PORT);
+Serial.print("Frame cycles (FastPin): ");
+Serial.println(Display.measureFrameCycles());
+Serial.print("Dim tick cycles: ");
+Serial.println(Display.measureDimCycles());
+#endif
+
   // Start LED patterns
   LEDs.begin();
 
-  // Map handlers
-  mapModeHandlers();
-  mapButtonHandlers();
-  mapCycleHandlers();
+  // Timer1 now counts CPU cycles, which the interrupt profile needs
+  Profiler.begin();
+
+  // Start background melody playback
+  Audio.begin();
+
+#if DEBUG
+Serial.print("LED update cycles: ");
+Serial.println(LEDs.measureUpdateCycles());
+Serial.print("LED state cycles (digitalWrite): ");
+Serial.println(LEDs.measureStateCycles(true));
+Serial.print("LED state cycles (FastPin): ");
+Serial.println(LEDs.measureStateCycles(false));
+Serial.print("Mode dispatch cycles: ");
+Serial.println(measureDispatchCycles());
+#endif
+
+  // Register tasks, highest priority first
+  addTasks();
 
   // Set alarm indicator
   updateAlarmIndicator();
@@ -163,11 +284,12 @@ Serial.println("Firmware Version 001");
 Serial.println("RTC not running; switching to set time mode");
 #endif
     // Start at default time
-    DS1307RTC.setDateTime(0, timeSetMinutes, timeSetHours, 1, 1, 1, 0, 
-        timeSetTwelveHourMode, timeSetAmPm, true, 0x10);
+    Clock.setDateTime(0, timeSetMinutes, timeSetHours, 1, 1, 1, 0, 
+        timeSetTwelveHourMode, timeSetAmPm);
 
     // Set default alarm settings
     saveAlarmToRam();
+    Settings.flush();
 
     // Clock is not running, probably powering up for the first time, change 
     // mode to set time
@@ -175,35 +297,142 @@ Serial.println("RTC not running; switching to set time mode");
   }
   else
   {
+    // Load the local time keeper
+    Clock.begin();
+
     getAlarmFromRam();
 #if DEBUG
 Serial.println("Got alarm settings from RAM");
-Serial.print(alarmHours);
-Serial.print(":");
-Serial.println(alarmMinutes);
+Serial.print("Next alarm at minute ");
+Serial.println(Alarms.getNextFire());
 #endif
   }
 }
 
 void loop()
 {
-  // Take care of any button presses first
-  if (timeSetButtonPressTime > 0 && alarmSetButtonPressTime > 0)
-  {
-    processDualButtonPress();
-  }
-  else if (timeSetButtonPressTime > 0)
-  {
-    processTimeButtonPress();
-  }
-  else if (alarmSetButtonPressTime > 0)
+  unsigned long start = micros();
+
+  Tasks.run();
+  Telemetry.recordLoop(micros() - start);
+  Idle.sleep(canPowerDown());
+}
+
+/**
+ * Power-down stops millis(), TWI and the piezo, so it is kept for a blanked
+ * clock with nothing in progress. The square wave still ticks the clock
+ * twice a second, and a button press wakes it.
+ */
+boolean canPowerDown()
+{
+  return currentRunMode == RUN_BLANK && unblankTime == 0 &&
+      !timeSetButtonDown && !alarmSetButtonDown && Buttons.isSettled() &&
+      I2C.isIdle() && !Settings.isDirty() && !Audio.isPlaying();
+}
+
+/*******************************************************************************
+ *
+ * State Machine
+ *
+ ******************************************************************************/
+
+/**
+ * What each run mode does and how the buttons move between modes. Rows must
+ * be in RunMode order; the compiler checks that, and that none are missing.
+ */
+static constexpr RunModeState runModes[NUM_RUN_MODES] PROGMEM = {
+  // mode, handler, time button, alarm button, dual button, enter, exit
+  {RUN, &runModeHandler, &runModeTimeButtonHandler, &runModeAlarmButtonHandler,
+      RUN_BLANK, &enableEntireDisplay, &noModeAction},
+  {RUN_BLANK, &runBlankModeHandler, &runBlankModeButtonHandler, &runBlankModeButtonHandler,
+      RUN, &disableEntireDisplay, &noModeAction},
+  {RUN_ALARM, &runAlarmModeHandler, &runAlarmModeButtonHandler, &runAlarmModeButtonHandler,
+      RUN_ALARM, &enableEntireDisplay, &exitRunAlarmMode},
+  {SET_TIME, &setTimeModeHandler, &setModeTimeButtonHandler, &setModeAlarmButtonHandler,
+      SET_TIME, &enterSetTimeMode, &exitSetTimeMode},
+  {SET_ALARM, &setAlarmModeHandler, &setModeTimeButtonHandler, &setModeAlarmButtonHandler,
+      SET_ALARM, &enterSetAlarmMode, &exitSetAlarmMode}
+};
+
+static_assert(runModesValid(runModes, 0), "run mode table is incomplete or out of order");
+
+/**
+ * The sub-modes of setting the time or the alarm, in the order the alarm
+ * button steps through them.
+ */
+static constexpr SetModeState setModes[NUM_SET_MODES] PROGMEM = {
+  // mode, handler, cycle, next, flags
+  {NONE, &noneSetModeHandler, &noneSetModeCycleHandler, HR_12_24, 0},
+  {HR_12_24, &hour12_24SetModeHandler, &twelveHourSetModeCycleHandler, HR_TENS, SET_MODE_TIME_ONLY},
+  {HR_TENS, &hourTensSetModeHandler, &hourTensSetModeCycleHandler, HR_ONES, 0},
+  {HR_ONES, &hourOnesSetModeHandler, &hourOnesSetModeCycleHandler, MIN_TENS, 0},
+  {MIN_TENS, &minTensSetModeHandler, &minTensSetModeCycleHandler, MIN_ONES, 0},
+  {MIN_ONES, &minOnesSetModeHandler, &minOnesSetModeCycleHandler, AMPM, 0},
+  {AMPM, &ampmSetModeHandler, &ampmSetModeCycleHandler, DAY_OF_WEEK, SET_MODE_TWELVE_HOUR_ONLY},
+  {DAY_OF_WEEK, &dayOfWeekSetModeHandler, &dayOfWeekSetModeCycleHandler, NONE, SET_MODE_TIME_ONLY}
+};
+
+static_assert(setModesValid(setModes, 0), "set mode table is incomplete or out of order");
+static_assert(setModeCycleLength(setModes, setModes[NONE].next, 1) == NUM_SET_MODES,
+    "set modes don't form a single cycle through NONE");
+
+// Handlers are fetched from flash and called directly
+inline void runModeAction(const ModeHandler *handler)
+{
+  ((ModeHandler) pgm_read_ptr(handler))();
+}
+
+inline void runButtonAction(const ButtonHandler *handler, boolean longPress)
+{
+  ((ButtonHandler) pgm_read_ptr(handler))(longPress);
+}
+
+/**
+ * Dispatches the no-op NONE cycle handler DISPATCH_MEASURE_COUNT times and
+ * returns the average cost of one dispatch in CPU cycles, call included.
+ * Only meaningful on the hardware.
+ */
+uint16_t measureDispatchCycles()
+{
+  unsigned long start = micros();
+
+  for (uint8_t i = 0; i < DISPATCH_MEASURE_COUNT; i++)
+    runModeAction(&setModes[NONE].cycle);
+
+  unsigned long elapsed = micros() - start;
+
+  return elapsed * (F_CPU / 1000000L) / DISPATCH_MEASURE_COUNT;
+}
+
+#if DEBUG
+/**
+ * Prints the entries and cycle costs of each interrupt handler, and the
+ * longest one has run with a pin change pending, which bounds how long the
+ * pin change waited.
+ */
+void printIsrProfile()
+{
+  IsrStats stats;
+
+  for (uint8_t i = 0; i < NUM_PROFILED_ISRS; i++)
   {
-    processAlarmButtonPress();
+    Profiler.getStats(i, &stats);
+    Serial.print("ISR ");
+    Serial.print(i);
+    Serial.print(": ");
+    Serial.print(stats.entries);
+    Serial.print(" entries, max ");
+    Serial.print(stats.maxCycles);
+    Serial.print(" cycles, mean ");
+    Serial.print(stats.meanCycles);
+    Serial.print(", nested ");
+    Serial.println(stats.nested);
   }
-  
-  // Call the handler function for the current mode (state)
-  runModeHandlerMap[currentRunMode]();
+
+  Serial.print("Pin change blocked by at most: ");
+  Serial.println(Profiler.getMaxPinChangeBlock());
 }
+#endif
 
 /*******************************************************************************
  *
@@ -212,117 +441,223 @@ void loop()
  ******************************************************************************/
 
 /**
- * Map the various run modes to run mode handler functions.
- * Map the various set sub-modes to set mode handler functions.
+ * Register the scheduler tasks. Tasks run in the order they are added, so
+ * buttons come first to keep press-to-response latency low.
  */
-void mapModeHandlers()
+void addTasks()
 {
-  runModeHandlerMap[RUN] = &runModeHandler;
-  runModeHandlerMap[SET_TIME] = &setTimeModeHandler;
-  runModeHandlerMap[SET_ALARM] = &setAlarmModeHandler;
-  runModeHandlerMap[RUN_BLANK] = &runBlankModeHandler;
-  runModeHandlerMap[RUN_ALARM] = &runAlarmModeHandler;
+  buttonTask = Tasks.add(&buttonTaskHandler, BUTTON_TASK_PERIOD, BUTTON_TASK_DEADLINE);
+  i2cTask = Tasks.add(&i2cTaskHandler, I2C_TASK_PERIOD, I2C_TASK_DEADLINE);
+  clockTask = Tasks.add(&clockTaskHandler, CLOCK_TASK_PERIOD, CLOCK_TASK_DEADLINE);
+  modeTask = Tasks.add(&modeTaskHandler, MODE_TASK_PERIOD, MODE_TASK_DEADLINE);
+  ledTask = Tasks.add(&ledTaskHandler, LED_TASK_PERIOD, LED_TASK_DEADLINE);
+  alarmTask = Tasks.add(&alarmTaskHandler, 0, ALARM_TASK_DEADLINE);
+  alarmShowTask = Tasks.add(&alarmShowTaskHandler, 0, ALARM_SHOW_TASK_DEADLINE);
+  uploadTask = Tasks.add(&uploadTaskHandler, 0, UPLOAD_TASK_DEADLINE);
+
+  if (Uploader.isUploading())
+    Tasks.schedule(uploadTask, 0);
+}
 
-  setModeHandlerMap[NONE] = &noneSetModeHandler;
-  setModeHandlerMap[HR_12_24] = &hour12_24SetModeHandler;
-  setModeHandlerMap[HR_TENS] = &hourTensSetModeHandler;
-  setModeHandlerMap[HR_ONES] = &hourOnesSetModeHandler;
-  setModeHandlerMap[MIN_TENS] = &minTensSetModeHandler;
-  setModeHandlerMap[MIN_ONES] = &minOnesSetModeHandler;
-  setModeHandlerMap[AMPM] = &ampmSetModeHandler;
+/**
+ * Leaves the current run mode and enters newMode, through the exit and enter
+ * actions in the run mode table.
+ */
+void changeRunMode(enum RunMode newMode)
+{
+  runModeAction(&runModes[currentRunMode].exit);
+  runModeAction(&runModes[newMode].enter);
+  currentRunMode = newMode;
 }
 
+void changeSetMode(enum SetMode newMode)
+{
+  currentSetMode = newMode;
+}
+
+/*******************************************************************************
+ *
+ * Tasks
+ *
+ ******************************************************************************/
+
 /**
- * Map button presses in different run modes to their handler functions.
+ * Handles everything the pin change interrupt has seen since the last run,
+ * in order, then samples the buttons and checks held ones for long presses.
  */
-void mapButtonHandlers()
+void buttonTaskHandler()
 {
-  // Time button handlers
-  timeButtonHandlerMap[RUN] = &runModeTimeButtonHandler;
-  timeButtonHandlerMap[SET_TIME] = &setModeTimeButtonHandler;
-  timeButtonHandlerMap[RUN_BLANK] = &runBlankModeButtonHandler;
-  timeButtonHandlerMap[SET_ALARM] = &setModeTimeButtonHandler;
-  timeButtonHandlerMap[RUN_ALARM] = &runAlarmModeButtonHandler;
+  Event event;
+
+  while (Events.pop(&event))
+    processEvent(&event);
+
+  Buttons.update();
+
+  unsigned long now = micros();
+  uint8_t pressed = Buttons.fallingEdge();
+  uint8_t released = Buttons.risingEdge();
+
+  // Presses first, so buttons pressed on the same sample make a dual press
+  event.time = now;
+
+  if (pressed & _BV(TIME_BTN_PIN))
+  {
+    event.type = EVENT_TIME_DOWN;
+    processEvent(&event);
+  }
+
+  if (pressed & _BV(ALRM_BTN_PIN))
+  {
+    event.type = EVENT_ALARM_DOWN;
+    processEvent(&event);
+  }
+
+  if (released & _BV(TIME_BTN_PIN))
+  {
+    event.type = EVENT_TIME_UP;
+    processEvent(&event);
+  }
+
+  if (released & _BV(ALRM_BTN_PIN))
+  {
+    event.type = EVENT_ALARM_UP;
+    processEvent(&event);
+  }
 
-  // Alarm button handlers
-  alarmButtonHandlerMap[RUN] = &runModeAlarmButtonHandler;
-  alarmButtonHandlerMap[SET_TIME] = &setModeAlarmButtonHandler;
-  alarmButtonHandlerMap[RUN_BLANK] = &runBlankModeButtonHandler;
-  alarmButtonHandlerMap[SET_ALARM] = &setModeAlarmButtonHandler;
-  alarmButtonHandlerMap[RUN_ALARM] = &runAlarmModeButtonHandler;
+  processButtonPresses(now);
+}
+
+void i2cTaskHandler()
+{
+  I2C.update();
+  Settings.update();
 }
 
 /**
- * Map handlers that cycle (advance) through the various set sub-modes.
- * For instance, the advance handler for the minute tens digit cycles
- * the output of that digit from 0 to 5.
+ * Runs until the upload is over, then gives the pins back to the LEDs.
  */
-void mapCycleHandlers()
+void uploadTaskHandler()
 {
-  // Convenience pointer
-  CycleHandler *map = &setModeCycleHandlerMap[0];
+  Uploader.update();
+
+  if (Uploader.isUploading())
+  {
+    Tasks.schedule(uploadTask, UPLOAD_TASK_INTERVAL);
+    return;
+  }
 
-  map[NONE] = &noneSetModeCycleHandler;
-  map[HR_12_24] = &twelveHourSetModeCycleHandler;
-  map[HR_TENS] = &hourTensSetModeCycleHandler;
-  map[HR_ONES] = &hourOnesSetModeCycleHandler;
-  map[MIN_TENS] = &minTensSetModeCycleHandler;
-  map[MIN_ONES] = &minOnesSetModeCycleHandler;
-  map[AMPM] = &ampmSetModeCycleHandler;
+#if DEBUG
+Serial.begin(DEBUG_BAUD);
+#endif
+  pinMode(AMPM_PIN, OUTPUT);
+  pinMode(ALRM_PIN, OUTPUT);
+  updateAlarmIndicator();
+  displayDirty = true;
 }
 
-void changeRunMode(enum RunMode newMode)
+void clockTaskHandler()
 {
-  switch (newMode)
+  Clock.update();
+  Telemetry.update();
+
+#if DEBUG
+  // Report what the interrupt handlers cost once a minute
+  static byte reportMinute = 0xFF;
+
+  if (currentMinutes != reportMinute)
   {
-    case SET_TIME:
-      Audio.playMelody(&TONE_UP_MELODY);
-      LEDs.setEnabled(false);
-      fetchTime(&timeSetHours, &timeSetMinutes, &timeSetAmPm, &timeSetTwelveHourMode);
-      changeSetMode(NONE);
-      break;
+    reportMinute = currentMinutes;
+    printIsrProfile();
+  }
+#endif
+}
 
-    case SET_ALARM:
-      Audio.playMelody(&TONE_UP2_MELODY);
-      LEDs.setEnabled(false);
-      timeSetHours = alarmHours;
-      timeSetMinutes = alarmMinutes;
-      timeSetAmPm = alarmAmPm;
-      changeSetMode(NONE);
-      break;
+void modeTaskHandler()
+{
+  enum RunMode mode = currentRunMode;
+  unsigned long start = micros();
 
-    case RUN:
-      if (currentRunMode == SET_TIME)
-      {
-        Audio.playMelodyBackwards(&TONE_UP_MELODY);
-      }
-      else if (currentRunMode == SET_ALARM)
-      {
-        Audio.playMelodyBackwards(&TONE_UP2_MELODY);
-      }
-
-      enableEntireDisplay();
-      break;
+  // Call the handler function for the current mode (state)
+  runModeAction(&runModes[mode].handler);
+  Telemetry.recordModeHandler(mode, micros() - start);
 
-    case RUN_BLANK:
-      disableEntireDisplay();
-      break;
+  // Ramp towards the scheduled brightness
+  Display.update();
+}
 
-    case RUN_ALARM:
-      enableEntireDisplay();
-      break;
+void ledTaskHandler()
+{
+  // The set modes use the LEDs to show which digit is being set
+  if (currentRunMode == RUN)
+    LEDs.update(Tasks.getDue());
+  else
+    LEDs.hold();
+}
 
-    default:
-      // NO-OP
-      break;
-  }
+void alarmTaskHandler()
+{
+  byte hour = toTwentyFourHour(currentHours, currentAmPm, currentTwelveHourMode);
 
-  currentRunMode = newMode;
+  checkAlarm(AlarmSchedule::minuteOfWeek(Clock.getDayOfWeek(), hour, currentMinutes));
 }
 
-void changeSetMode(enum SetMode newMode)
+/**
+ * Continuation of toggleAlarm: ends the alarm time display.
+ */
+void alarmShowTaskHandler()
 {
-  currentSetMode = newMode;
+  alarmShowing = false;
+  LEDs.resume();
+  displayDirty = true;
+}
+
+/*******************************************************************************
+ *
+ * Run Mode Enter/Exit Actions
+ *
+ ******************************************************************************/
+
+void noModeAction()
+{
+  // NO-OP
+}
+
+void enterSetTimeMode()
+{
+  Audio.play(&TONE_UP_MELODY);
+  LEDs.setEnabled(false);
+  fetchTime(&timeSetHours, &timeSetMinutes, &timeSetAmPm, &timeSetTwelveHourMode);
+  timeSetDayOfWeek = constrain(Clock.getDayOfWeek(), 1, 7);
+  changeSetMode(NONE);
+}
+
+void exitSetTimeMode()
+{
+  Audio.playReverse(&TONE_UP_MELODY);
+}
+
+void enterSetAlarmMode()
+{
+  Audio.play(&TONE_UP2_MELODY);
+  LEDs.setEnabled(false);
+  const Alarm *alarm = Alarms.get(0);
+
+  // Shown the way the clock shows the time
+  timeSetTwelveHourMode = currentTwelveHourMode;
+  fromTwentyFourHour(alarm->hour, timeSetTwelveHourMode, &timeSetHours, &timeSetAmPm);
+  timeSetMinutes = alarm->minute;
+  changeSetMode(NONE);
+}
+
+void exitSetAlarmMode()
+{
+  Audio.playReverse(&TONE_UP2_MELODY);
+}
+
+void exitRunAlarmMode()
+{
+  Audio.stop();
 }
 
 /*******************************************************************************
@@ -333,20 +668,23 @@ void changeSetMode(enum SetMode newMode)
 
 void runModeHandler()
 {
-  LEDs.update();
+  // Leave the alarm time up until alarmShowTask ends the display
+  if (alarmShowing)
+    return;
+
   updateTime();
 }
 
 void setTimeModeHandler()
 {
   // Call the set mode sub-mode handlers
-  setModeHandlerMap[currentSetMode]();
+  runModeAction(&setModes[currentSetMode].handler);
 }
 
 void setAlarmModeHandler()
 {
   // Call the set mode sub-mode handlers
-  setModeHandlerMap[currentSetMode]();
+  runModeAction(&setModes[currentSetMode].handler);
 }
 
 void runBlankModeHandler()
@@ -367,8 +705,13 @@ void runAlarmModeHandler()
 {
   updateTime();
 
-  Audio.singleBeep();
-  delay(DUR_E);
+  if (Audio.isPlaying())
+    return;
+
+  if (Uploader.isValid())
+    Audio.play(Uploader.getData(), Uploader.getSize());
+  else
+    Audio.play(&ALARM_MELODY);
 }
 
 /*******************************************************************************
@@ -406,16 +749,8 @@ void setModeTimeButtonHandler(boolean longPress)
       timeSetAmPm = timeSetHours > 12;
     }
 
-    // Edge case for alarm
-    if (timeSetTwelveHourMode && (alarmHours > 12 || alarmHours == 0))
-    {
-      alarmHours = alarmHours == 0 ? 12 : alarmHours % 12;
-      alarmAmPm = alarmHours > 12;
-      saveAlarmToRam();
-    }
-
-    DS1307RTC.setDateTime(0, timeSetMinutes, timeSetHours, 1, 1, 1, 0, 
-        timeSetTwelveHourMode, timeSetAmPm, true, 0x10);
+    Clock.setDateTime(0, timeSetMinutes, timeSetHours, timeSetDayOfWeek, 1, 1, 0, 
+        timeSetTwelveHourMode, timeSetAmPm);
     enableEntireDisplay();
     changeRunMode(RUN);
   }
@@ -432,11 +767,12 @@ void setModeAlarmButtonHandler(boolean longPress)
 {
   if (longPress && currentRunMode == SET_ALARM)
   {
+    Alarm alarm = *Alarms.get(0);
+
     enableEntireDisplay();
-    alarmHours = timeSetHours;
-    alarmMinutes = timeSetMinutes;
-    alarmAmPm = timeSetAmPm;
-    saveAlarmToRam();
+    alarm.hour = toTwentyFourHour(timeSetHours, timeSetAmPm, timeSetTwelveHourMode);
+    alarm.minute = timeSetMinutes;
+    Alarms.set(0, &alarm);
     changeRunMode(RUN);
   }
   else
@@ -464,7 +800,6 @@ void runBlankModeButtonHandler(boolean longPress)
 void runAlarmModeButtonHandler(boolean longPress)
 {
   // Turn off the alarm
-  alarmRecentlySnuffed = true;
   changeRunMode(RUN);
 }
 
@@ -562,6 +897,19 @@ void minOnesSetModeHandler()
   }
 }
 
+void dayOfWeekSetModeHandler()
+{
+  if (blinkShouldBeOn())
+  {
+    Display.outputBytes(0, SegmentDisplay::DASH, SegmentDisplay::DASH, Display.mapBcd(timeSetDayOfWeek));
+    enableEntireDisplay();
+  }
+  else
+  {
+    disableEntireDisplay();
+  }
+}
+
 void ampmSetModeHandler()
 {
   if (blinkShouldBeOn())
@@ -574,7 +922,7 @@ void ampmSetModeHandler()
     );
     Display.setEnabled(true);
     LEDs.setLEDStates(true, true, true, true);
-    digitalWrite(AMPM_PIN, timeSetAmPm ? HIGH : LOW);
+    FastPin<AMPM_PIN>::write(timeSetAmPm);
   }
   else
   {
@@ -660,6 +1008,11 @@ void ampmSetModeCycleHandler()
   timeSetAmPm = !timeSetAmPm;
 }
 
+void dayOfWeekSetModeCycleHandler()
+{
+  timeSetDayOfWeek = timeSetDayOfWeek % 7 + 1;
+}
+
 /*******************************************************************************
  *
  * Helper Methods
@@ -673,7 +1026,7 @@ void ampmSetModeCycleHandler()
 void outputSetTime()
 {
   Display.outputTime(timeSetHours, timeSetMinutes);
-  digitalWrite(AMPM_PIN, timeSetAmPm);
+  FastPin<AMPM_PIN>::write(timeSetAmPm);
 }
 
 void cycleCurrentSetMode()
@@ -681,7 +1034,7 @@ void cycleCurrentSetMode()
   if (currentSetMode != NONE)
     skipNextBlink = true;
 
-  setModeCycleHandlerMap[currentSetMode]();
+  runModeAction(&setModes[currentSetMode].cycle);
 }
 
 /**
@@ -689,14 +1042,16 @@ void cycleCurrentSetMode()
  */
 void proceedToNextSetMode()
 {
-  // For 24 hour mode, skip setting AM/PM
-  byte divisor = timeSetTwelveHourMode ? NUM_SET_MODES : NUM_SET_MODES - 1;
+  // For 24 hour mode, skip setting AM/PM; for alarm set, skip 12/24 hour
+  byte skip = (timeSetTwelveHourMode ? 0 : SET_MODE_TWELVE_HOUR_ONLY) |
+      (currentRunMode == SET_ALARM ? SET_MODE_TIME_ONLY : 0);
+  SetMode mode = currentSetMode;
 
-  // For alarm set, skip 12/24 hour setting
-  byte increment = (currentSetMode == NONE && currentRunMode == SET_ALARM) ? 2 : 1;
+  do
+    mode = (SetMode) pgm_read_byte(&setModes[mode].next);
+  while (pgm_read_byte(&setModes[mode].flags) & skip);
 
-  // Warning: This assumes the enum values are listed in order of procession!
-  currentSetMode = (SetMode) ((currentSetMode + increment) % divisor);
+  changeSetMode(mode);
 }
 
 /**
@@ -704,22 +1059,35 @@ void proceedToNextSetMode()
  */
 void toggleAlarm()
 {
-  alarmEnabled = !alarmEnabled;
+  Alarm alarm = *Alarms.get(0);
+
+  alarm.flags ^= ALARM_ENABLED;
+  Alarms.set(0, &alarm);
   updateAlarmIndicator();
-  saveAlarmToRam();
 
-  if (alarmEnabled)
+  if (alarm.flags & ALARM_ENABLED)
   {
+    byte hours;
+    boolean ampm;
+
+    fromTwentyFourHour(alarm.hour, currentTwelveHourMode, &hours, &ampm);
     Audio.singleBeep();
-    Display.outputTime(alarmHours, alarmMinutes);
-    digitalWrite(AMPM_PIN, alarmAmPm);
+    Display.outputTime(hours, alarm.minute);
+    FastPin<AMPM_PIN>::write(ampm);
     LEDs.pause();
-    delay(ALARM_SHOW_INTERVAL);
-    LEDs.resume();
+    alarmShowing = true;
+    Tasks.schedule(alarmShowTask, ALARM_SHOW_INTERVAL);
   }
   else
   {
     Audio.doubleBeep();
+
+    // Disabled again while the alarm time was still showing
+    if (alarmShowing)
+    {
+      Tasks.cancel(alarmShowTask);
+      alarmShowTaskHandler();
+    }
   }
 }
 
@@ -759,161 +1127,246 @@ void updateTime()
 {
   if (displayDirty)
   {
-    byte minute, hour;
-    boolean ampm, twelveHourMode;
-
-    fetchTime(&hour, &minute, &ampm, &twelveHourMode);
+    fetchTime(&currentHours, &currentMinutes, &currentAmPm, &currentTwelveHourMode);
 
     if (Display.getEnabled())
     {
-      Display.outputTime(hour, minute);
-      digitalWrite(AMPM_PIN, ampm);
+      Display.outputTime(currentHours, currentMinutes);
+      FastPin<AMPM_PIN>::write(currentAmPm);
     }
 
-    checkAlarm(hour, minute, ampm, twelveHourMode);
+    updateBrightness();
+    Tasks.schedule(alarmTask, 0);
 
     displayDirty = false;
   }
 }
 
 /**
- * Checks to see if the alarm needs to be turned on
+ * Turns the alarm on when the schedule says one is due at now, a minute of
+ * the week, and off again once that minute has passed.
  */
-void checkAlarm(byte currentHours, byte currentMinutes, boolean currentAmPm, boolean twelveHourMode)
+void checkAlarm(uint16_t now)
 {
-  if (currentMinutes != alarmMinutes)
-  {
-    if (alarmRecentlySnuffed)
-      alarmRecentlySnuffed = false;
-
-    // Turn off the alarm once a minute has passed if no button was pressed
-    if (currentRunMode == RUN_ALARM)
-      changeRunMode(RUN);
+  // Turn off the alarm once a minute has passed if no button was pressed
+  if (currentRunMode == RUN_ALARM && now != alarmRingingMinute)
+    changeRunMode(RUN);
 
+  // Only look while an alarm could ring, as checking uses up one-shot
+  // alarms; one due while setting or ringing waits for its next day
+  if (currentRunMode != RUN && currentRunMode != RUN_BLANK)
     return;
-  }
-  
-  if (alarmEnabled && 
-      (currentRunMode == RUN || currentRunMode == RUN_BLANK) && 
-      !alarmRecentlySnuffed &&
-      currentHours == alarmHours && 
-      currentMinutes == alarmMinutes &&
-      ((currentAmPm == alarmAmPm && twelveHourMode == true) || twelveHourMode == false))
+
+  if (Alarms.check(now))
   {
     // Turn on the alarm
 #if DEBUG
 Serial.println("Turning on alarm");
 #endif
+    alarmRingingMinute = now;
     changeRunMode(RUN_ALARM);
   }
 }
 
 /**
- * Fetches the current time from the DS1307 RTC.
+ * Dims the display between the night hours in the settings. The change is
+ * ramped by Display.update().
+ */
+void updateBrightness()
+{
+  byte hour = toTwentyFourHour(currentHours, currentAmPm, currentTwelveHourMode);
+  byte nightStartHour = Settings.get(SETTING_NIGHT_START_HOUR);
+  byte nightEndHour = Settings.get(SETTING_NIGHT_END_HOUR);
+  boolean night;
+
+  if (nightStartHour <= nightEndHour)
+    night = hour >= nightStartHour && hour < nightEndHour;
+  else
+    night = hour >= nightStartHour || hour < nightEndHour;
+
+  Display.setBrightness(night ? Settings.get(SETTING_NIGHT_BRIGHTNESS) :
+      DISPLAY_BRIGHTNESS_LEVELS);
+}
+
+/**
+ * Converts an hour as shown in 12 or 24 hour mode to the 24 hour clock.
+ */
+byte toTwentyFourHour(byte hour, boolean ampm, boolean twelveHourMode)
+{
+  return twelveHourMode ? hour % 12 + (ampm ? 12 : 0) : hour;
+}
+
+/**
+ * Converts an hour on the 24 hour clock to the way 12 or 24 hour mode shows
+ * it.
+ */
+void fromTwentyFourHour(byte hour24, boolean twelveHourMode, byte *hour, boolean *ampm)
+{
+  *ampm = hour24 >= 12;
+
+  if (!twelveHourMode)
+    *hour = hour24;
+  else
+    *hour = hour24 % 12 == 0 ? 12 : hour24 % 12;
+}
+
+/**
+ * Fetches the current time from the local time keeper, which only goes to
+ * the DS1307 RTC when a resync is due.
  */
 boolean fetchTime(byte* hour, byte* minute, boolean* ampm, boolean* twelveHourMode)
 {
-  byte second, dayOfWeek, dayOfMonth, month, year;
-  DS1307RTC.getDateTime(&second, minute, hour, &dayOfWeek, &dayOfMonth, 
-      &month, &year, (bool*)twelveHourMode, (bool*)ampm);
+  Clock.getTime(hour, minute, (bool*)ampm, (bool*)twelveHourMode);
   
   return true;
 }
 
 /**
- * Alarm settings preservation scheme:
- *
- * Byte 0 = Hours
- * Byte 1 = Minutes
- * Byte 2 = AM/PM
- * Byte 3 = Enabled?
+ * Hands the alarm settings and the default night profile to the settings
+ * store (see Settings.h), which writes whatever changed back to DS1307 RAM
+ * once things settle. The custom alarm melody, if any, is kept from
+ * CUSTOM_MELODY_RAM_OFFSET on (see MelodyUpload.h).
  */
 void saveAlarmToRam()
 {
-  DS1307RTC.ramBuffer[0] = alarmHours;
-  DS1307RTC.ramBuffer[1] = alarmMinutes;
-  DS1307RTC.ramBuffer[2] = alarmAmPm;
-  DS1307RTC.ramBuffer[3] = alarmEnabled;
-  DS1307RTC.saveRamData(4);
+  Alarms.save();
+  Settings.set(SETTING_NIGHT_START_HOUR, NIGHT_START_HOUR);
+  Settings.set(SETTING_NIGHT_END_HOUR, NIGHT_END_HOUR);
+  Settings.set(SETTING_NIGHT_BRIGHTNESS, NIGHT_BRIGHTNESS);
 }
 
 void getAlarmFromRam()
 {
-  DS1307RTC.getRamData(4);
-  alarmHours = (byte) DS1307RTC.ramBuffer[0];
-  alarmMinutes = (byte) DS1307RTC.ramBuffer[1];
-  alarmAmPm = (boolean) DS1307RTC.ramBuffer[2];
-  alarmEnabled = (boolean) DS1307RTC.ramBuffer[3];
+  if (Settings.load())
+  {
+    Alarms.load();
+  }
+  else
+  {
+    // Lost or from an older layout; start over from the defaults
+    saveAlarmToRam();
+  }
+
+  Uploader.loadFromRam();
+
   updateAlarmIndicator();
 }
 
-void processDualButtonPress()
+void processEvent(Event *event)
+{
+  switch (event->type)
+  {
+    case EVENT_RTC_TICK:
+      displayDirty = true;
+      break;
+
+    case EVENT_TIME_DOWN:
+      timeSetButtonDown = true;
+      timeSetButtonPending = true;
+      timeSetButtonPressTime = event->time;
+      dualButtonPending |= alarmSetButtonPending;
+      break;
+
+    case EVENT_ALARM_DOWN:
+      alarmSetButtonDown = true;
+      alarmSetButtonPending = true;
+      alarmSetButtonPressTime = event->time;
+      dualButtonPending |= timeSetButtonPending;
+      break;
+
+    case EVENT_TIME_UP:
+      timeSetButtonDown = false;
+      processButtonPresses(event->time);
+      break;
+
+    case EVENT_ALARM_UP:
+      alarmSetButtonDown = false;
+      processButtonPresses(event->time);
+      break;
+  }
+}
+
+/**
+ * Handles any pending press that has been released or held long enough, as
+ * of the given time.
+ */
+void processButtonPresses(unsigned long now)
 {
-  boolean longPress = timeSetButtonPressedLong() && alarmSetButtonPressedLong();
+  if (dualButtonPending)
+  {
+    processDualButtonPress(now);
+  }
+  else if (timeSetButtonPending)
+  {
+    processTimeButtonPress(now);
+  }
+  else if (alarmSetButtonPending)
+  {
+    processAlarmButtonPress(now);
+  }
+}
 
-  if ((alarmSetButtonDebouncer.read() && timeSetButtonDebouncer.read()) || longPress)
+void processDualButtonPress(unsigned long now)
+{
+  boolean longPress = timeSetButtonPressedLong(now) && alarmSetButtonPressedLong(now);
+
+  if ((!alarmSetButtonDown && !timeSetButtonDown) || longPress)
   {
 #if DEBUG
 Serial.print(longPress ? "Long" : "Short");
 Serial.println(" dual button press");
 #endif
-    timeSetButtonPressTime = 0;
-    alarmSetButtonPressTime = 0;
+    timeSetButtonPending = false;
+    alarmSetButtonPending = false;
+    dualButtonPending = false;
 
-    // Only use run mode for now
-    if (currentRunMode == RUN)
-    {
-      changeRunMode(RUN_BLANK);
-    }
-    else if (currentRunMode == RUN_BLANK)
-    {
-      changeRunMode(RUN);
-    }
+    RunMode newMode = (RunMode) pgm_read_byte(&runModes[currentRunMode].dualButton);
+
+    if (newMode != currentRunMode)
+      changeRunMode(newMode);
   }
 }
 
-void processTimeButtonPress()
+void processTimeButtonPress(unsigned long now)
 {
-  boolean longPress = timeSetButtonPressedLong();
+  boolean longPress = timeSetButtonPressedLong(now);
 
-  if (timeSetButtonDebouncer.read() || longPress) 
+  if (!timeSetButtonDown || longPress) 
   {
 #if DEBUG
 Serial.print(longPress ? "Long" : "Short");
 Serial.println(" time button press");
 #endif
   
-    timeSetButtonPressTime = 0;
-    timeButtonHandlerMap[currentRunMode](longPress);
+    timeSetButtonPending = false;
+    runButtonAction(&runModes[currentRunMode].timeButton, longPress);
   }
 }
 
-void processAlarmButtonPress()
+void processAlarmButtonPress(unsigned long now)
 {
-  boolean longPress = alarmSetButtonPressedLong();
+  boolean longPress = alarmSetButtonPressedLong(now);
 
-  if (alarmSetButtonDebouncer.read() || longPress)
+  if (!alarmSetButtonDown || longPress)
   {
 #if DEBUG
 Serial.print(longPress ? "Long" : "Short");
 Serial.println(" alarm button press");
 #endif
   
-    alarmSetButtonPressTime = 0;
-    alarmButtonHandlerMap[currentRunMode](longPress);
+    alarmSetButtonPending = false;
+    runButtonAction(&runModes[currentRunMode].alarmButton, longPress);
   }
 }
 
-inline boolean alarmSetButtonPressedLong()
+inline boolean alarmSetButtonPressedLong(unsigned long now)
 {
-  alarmSetButtonDebouncer.update();
-  return (!alarmSetButtonDebouncer.read() && (millis() - alarmSetButtonPressTime >= LONG_PRESS));
+  return (now - alarmSetButtonPressTime) / 1000 >= LONG_PRESS;
 }
 
-inline boolean timeSetButtonPressedLong()
+inline boolean timeSetButtonPressedLong(unsigned long now)
 {
-  timeSetButtonDebouncer.update();
-  return (!timeSetButtonDebouncer.read() && (millis() - timeSetButtonPressTime >= LONG_PRESS));
+  return (now - timeSetButtonPressTime) / 1000 >= LONG_PRESS;
 }
 
 /**
@@ -923,8 +1376,8 @@ void disableEntireDisplay()
 {
   Display.setEnabled(false);
   LEDs.setEnabled(false);
-  digitalWrite(AMPM_PIN, LOW);
-  digitalWrite(ALRM_PIN, LOW);
+  FastPin<AMPM_PIN>::low();
+  FastPin<ALRM_PIN>::low();
 }
 
 /**
@@ -945,36 +1398,45 @@ void enableDisplayWithoutLEDs()
 
 void updateAmPmIndicator()
 {
-  digitalWrite(AMPM_PIN, timeSetAmPm);
+  FastPin<AMPM_PIN>::write(timeSetAmPm);
 }
 
 void updateAlarmIndicator()
 {
-  digitalWrite(ALRM_PIN, alarmEnabled);
+  FastPin<ALRM_PIN>::write(Alarms.anyEnabled());
 }
 
 /**
- * This interrupt will be called every time the DS1307 square wave pin changes 
- * or a button is pressed. For the RTC, at 1Hz this means this will be called 
- * twice per second (high to low, low to high).
+ * This interrupt will be called every time the DS1307 square wave pin changes.
+ * At 1Hz this means this will be called twice per second (high to low, low 
+ * to high). It only samples the port, counts the tick and queues its time;
+ * everything else happens in the button task. The clock and queue calls are
+ * inline, but micros() is still a call, so the handler saves every
+ * call-clobbered register all the same.
  */
 ISR (PCINT2_vect)
 {
-  // Instead of digitalRead, we'll read the port directly for Arduino digital 
-  // pin 2, 4 and 5 (all of which reside in PORTD)
-  // This keeps the execution time of the interrupt a bit shorter
-  
-  // Check for RTC square wave low
-  // Here, we look for when pin 4 (4th bit in PIND) is pulled low (value == 0), 
-  // meaning 1 second has passed
-  if ((PIND & 0x10) == 0) 
-    displayDirty = true;
-  
-  // Check for time button press (pulled low) on pin 5
-  if (timeSetButtonDebouncer.update() && !timeSetButtonDebouncer.read())
-    timeSetButtonPressTime = millis();
+  uint16_t start = Profiler.enter(ISR_PCINT2);
+
+  // Read the port directly rather than through digitalRead, to keep the
+  // interrupt short
+  static byte lastPind = FastPin<HZ_PIN>::BIT;
+  byte pind = PIND;
+
+  // Check for RTC square wave falling edge, meaning 1 second has passed
+  bool tick = (lastPind & FastPin<HZ_PIN>::BIT) && (pind & FastPin<HZ_PIN>::BIT) == 0;
+
+  if (tick)
+  {
+    Clock.tick();
+    Events.push(EVENT_RTC_TICK, micros());
+  }
+
+#if INPUT_TRACE
+  Recorder.record(pind, tick);
+#endif
+
+  lastPind = pind;
 
-  // Check for alarm button press (pulled low) on pin 2
-  if (alarmSetButtonDebouncer.update() && !alarmSetButtonDebouncer.read())
-    alarmSetButtonPressTime = millis();
+  Profiler.exit(ISR_PCINT2, start);
 }
@@ -1,64 +0,0 @@
-/*******************************************************************************
- * Copyright (C) Thomas O Fredericks
- * Rebounce and duration functions contributed by Eric Lowry
- * Write function contributed by Jim Schimpf
- * risingEdge and fallingEdge contributed by Tom Harkaway
- *
- * Modifications Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
- *
- * This program is free software: you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation, either version 3 of the License, or
- * (at your option) any later version.
- *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program.  If not, see <http://www.gnu.org/licenses/>.
- ******************************************************************************/
-
-#ifndef BOUNCE_H_
-#define BOUNCE_H_
-
-#include <Arduino.h>
-#include <inttypes.h>
-
-class Bounce
-{
-
-  public:
-    // Initialize
-    Bounce(uint8_t pin, unsigned long interval_millis ); 
-    // Sets the debounce interval
-    void interval(unsigned long interval_millis); 
-    // Updates the pin
-    // Returns 1 if the state changed
-    // Returns 0 if the state did not change
-    int update(); 
-    // Forces the pin to signal a change (through update()) in X milliseconds 
-    // even if the state does not actually change
-    // Example: press and hold a button and have it repeat every X milliseconds
-    void rebounce(unsigned long interval); 
-    // Returns the updated pin state
-    int read();
-    // Sets the stored pin state
-    void write(int new_state);
-      // Returns the number of milliseconds the pin has been in the current state
-    unsigned long duration();
-    // The risingEdge method is true for one scan after the de-bounced input goes from off-to-on.
-    bool risingEdge();
-    // The fallingEdge  method it true for one scan after the de-bounced input goes from on-to-off. 
-    bool fallingEdge();
-    
-  protected:
-    int debounce();
-    volatile unsigned long  previous_millis, interval_millis, rebounce_millis;
-    volatile uint8_t state;
-    uint8_t pin;
-    volatile uint8_t stateChanged;
-};
-
-#endif
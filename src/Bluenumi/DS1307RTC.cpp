@@ -24,11 +24,19 @@ extern "C" {
 
 DS1307::DS1307()
 {
+  for (uint8_t i = 0; i < DS1307_REQUESTS; i++)
+  {
+    requests[i].address = DS1307_I2C_ADDRESS;
+    requests[i].status = I2C_STATUS_OK;
+  }
+
+  queued = 0;
+  last = DS1307_REQUESTS - 1;
 }
 
 void DS1307::begin()
 {
-  Wire.begin();
+  I2C.begin();
 }
 
 void DS1307::setDateTime( 
@@ -44,70 +52,102 @@ void DS1307::setDateTime(
   bool startClock,
   uint8_t controlRegister) 
 {
-  Wire.beginTransmission(DS1307_I2C_ADDRESS);
-  Wire.write((uint8_t) 0x00);
-  Wire.write(decToBcd(second) | (startClock ? 0x00 : 0x80 )); // 0 to bit 7 starts the clock, 1 stops
-  Wire.write(decToBcd(minute));
+  // Wait before touching the buffer a transaction may still be sending
+  wait();
+
+  registers[0] = decToBcd(second) | (startClock ? 0x00 : 0x80 ); // 0 to bit 7 starts the clock, 1 stops
+  registers[1] = decToBcd(minute);
 
   if (twelveHourMode) 
   {
-    Wire.write(decToBcd(hour) | ( ampm ? 0x60 : 0x40 ) );
+    registers[2] = decToBcd(hour) | ( ampm ? 0x60 : 0x40 );
   }
   else 
   {
-    Wire.write( decToBcd( hour ) );
+    registers[2] = decToBcd( hour );
   }
 
-  Wire.write( decToBcd( dayOfWeek ) );
-  Wire.write( decToBcd( dayOfMonth ) );
-  Wire.write( decToBcd( month ) );
-  Wire.write( decToBcd( year ) );
-  Wire.write( controlRegister );
-  Wire.endTransmission();
+  registers[3] = decToBcd( dayOfWeek );
+  registers[4] = decToBcd( dayOfMonth );
+  registers[5] = decToBcd( month );
+  registers[6] = decToBcd( year );
+  registers[7] = controlRegister;
+
+  wait(submit(0x00, registers, sizeof(registers), false, NULL));
 }
 
 bool DS1307::isRunning()
 {
-  setRegisterPointer(0x00);
-  
-  Wire.requestFrom(DS1307_I2C_ADDRESS, 1);
+  if (wait(submit(0x00, registers, 1, true, NULL)) != I2C_STATUS_OK)
+    return false;
   
-  if (Wire.read() & 0x80) 
+  if (registers[0] & 0x80) 
     return false;
   
   return true;
 }
 
-void DS1307::saveRamData(uint8_t numBytes)
+/**
+ * Reads every register, from the seconds to the end of RAM, into data,
+ * which must hold DS1307_REGISTERS bytes.
+ */
+bool DS1307::readRegisters(uint8_t *data)
+{
+  return wait(submit(0x00, data, DS1307_REGISTERS, true, NULL)) == I2C_STATUS_OK;
+}
+
+bool DS1307::saveRamData(uint8_t numBytes)
 {
-  numBytes = min(numBytes, RAM_SIZE);
+  return wait(submit(0x08, ramBuffer, min(numBytes, RAM_SIZE), false, NULL)) == I2C_STATUS_OK;
+}
 
-  Wire.beginTransmission(DS1307_I2C_ADDRESS);
-  Wire.write((uint8_t) 0x08);
+bool DS1307::getRamData(uint8_t numBytes)
+{
+  return getRamRange(0, numBytes);
+}
 
-  for (uint8_t i = 0; i < numBytes; i++)
-  {
-    Wire.write(ramBuffer[i]);
-  }
+/**
+ * Reads numBytes of RAM, from offset on, into the same place in ramBuffer.
+ */
+bool DS1307::getRamRange(uint8_t offset, uint8_t numBytes)
+{
+  if (offset >= RAM_SIZE)
+    return false;
 
-  Wire.endTransmission();
+  return wait(submit(0x08 + offset, ramBuffer + offset, min(numBytes, RAM_SIZE - offset), 
+      true, NULL)) == I2C_STATUS_OK;
 }
 
-void DS1307::getRamData(uint8_t numBytes)
+bool DS1307::getDateTime( 
+  uint8_t *second, 
+  uint8_t *minute, 
+  uint8_t *hour, 
+  uint8_t *dayOfWeek, 
+  uint8_t *dayOfMonth, 
+  uint8_t *month, 
+  uint8_t *year,
+  bool *twelveHourMode,
+  bool *ampm )
 {
-  numBytes = min(numBytes, RAM_SIZE);
+  if (wait(submit(0x00, registers, DS1307_TIME_REGISTERS, true, NULL)) != I2C_STATUS_OK)
+    return false;
 
-  setRegisterPointer(0x08);
+  readDateTime(second, minute, hour, dayOfWeek, dayOfMonth, month, year, 
+      twelveHourMode, ampm);
 
-  Wire.requestFrom(DS1307_I2C_ADDRESS, RAM_SIZE);
+  return true;
+}
 
-  for (uint8_t i = 0; i < numBytes; i++)
-  {
-    ramBuffer[i] = Wire.read();
-  }
+/**
+ * Starts reading the time registers. Once the callback sees I2C_STATUS_OK, 
+ * readDateTime() unpacks them.
+ */
+bool DS1307::requestDateTime(I2CCallback callback)
+{
+  return submit(0x00, registers, DS1307_TIME_REGISTERS, true, callback) != NULL;
 }
 
-void DS1307::getDateTime( 
+void DS1307::readDateTime( 
   uint8_t *second, 
   uint8_t *minute, 
   uint8_t *hour, 
@@ -118,17 +158,13 @@ void DS1307::getDateTime(
   bool *twelveHourMode,
   bool *ampm )
 {
-  setRegisterPointer(0x00);
-
-  Wire.requestFrom(DS1307_I2C_ADDRESS, 7);
-
-  *second     = bcdToDec(Wire.read() & 0x7f); // Mask out the CH bit
-  *minute     = bcdToDec(Wire.read());
-  *hour       = Wire.read();
-  *dayOfWeek  = bcdToDec(Wire.read());
-  *dayOfMonth = bcdToDec(Wire.read());
-  *month      = bcdToDec(Wire.read());
-  *year       = bcdToDec(Wire.read());
+  *second     = bcdToDec(registers[0] & 0x7f); // Mask out the CH bit
+  *minute     = bcdToDec(registers[1]);
+  *hour       = registers[2];
+  *dayOfWeek  = bcdToDec(registers[3]);
+  *dayOfMonth = bcdToDec(registers[4]);
+  *month      = bcdToDec(registers[5]);
+  *year       = bcdToDec(registers[6]);
   *twelveHourMode = (*hour & 0x40) == 0 ? false : true;
   
   if (*twelveHourMode) 
@@ -143,11 +179,127 @@ void DS1307::getDateTime(
   }
 }
 
-void DS1307::setRegisterPointer(uint8_t val)
+/**
+ * Starts reading RAM into ramBuffer.
+ */
+bool DS1307::requestRamData(uint8_t numBytes, I2CCallback callback)
+{
+  return requestRamRange(0, numBytes, callback);
+}
+
+/**
+ * Starts reading numBytes of RAM, from offset on, into the same place in
+ * ramBuffer.
+ */
+bool DS1307::requestRamRange(uint8_t offset, uint8_t numBytes, I2CCallback callback)
+{
+  if (offset >= RAM_SIZE)
+    return false;
+
+  return submit(0x08 + offset, ramBuffer + offset, min(numBytes, RAM_SIZE - offset), true, 
+      callback) != NULL;
+}
+
+/**
+ * Starts writing ramBuffer to RAM. ramBuffer is read as the bytes go out, 
+ * so changes made before the callback runs may or may not be written.
+ */
+bool DS1307::sendRamData(uint8_t numBytes, I2CCallback callback)
+{
+  return sendRamRange(0, numBytes, callback);
+}
+
+/**
+ * Starts writing numBytes of ramBuffer, from offset on, to the same place
+ * in RAM as one transaction.
+ */
+bool DS1307::sendRamRange(uint8_t offset, uint8_t numBytes, I2CCallback callback)
+{
+  if (offset >= RAM_SIZE)
+    return false;
+
+  return submit(0x08 + offset, ramBuffer + offset, min(numBytes, RAM_SIZE - offset), false, 
+      callback) != NULL;
+}
+
+/**
+ * True while any transaction is queued or not yet reported.
+ */
+bool DS1307::isBusy()
+{
+  return queued != 0;
+}
+
+/**
+ * Waits for every queued transaction to finish and be reported, and returns
+ * how the last one ended.
+ */
+uint8_t DS1307::wait()
+{
+  // A callback run while waiting may queue another transaction
+  while (queued)
+    wait(&requests[last]);
+
+  return requests[last].status;
+}
+
+/**
+ * Waits for one transaction to finish and be reported, which also reports
+ * the ones queued before it. Returns how it ended, or I2C_STATUS_BUS_ERROR
+ * for a request that never made it into the queue.
+ */
+uint8_t DS1307::wait(I2CRequest *request)
+{
+  if (!request)
+    return I2C_STATUS_BUS_ERROR;
+
+  I2C.wait(request);
+
+  return request->status;
+}
+
+/**
+ * Queues a transaction in the next request, which is the oldest. Requests
+ * are reported in order, so it is only still queued when every request is,
+ * and then this waits for it. Returns NULL if the bus refuses it.
+ */
+I2CRequest *DS1307::submit(uint8_t reg, uint8_t *data, uint8_t length, bool read, 
+    I2CCallback callback)
+{
+  uint8_t index = (last + 1) % DS1307_REQUESTS;
+  I2CRequest *request = &requests[index];
+
+  while (queued & _BV(index))
+    I2C.wait(request);
+
+  request->reg = reg;
+  request->data = data;
+  request->length = length;
+  request->read = read;
+  request->callback = &finished;
+  callbacks[index] = callback;
+
+  if (!I2C.submit(request))
+    return NULL;
+
+  queued |= _BV(index);
+  last = index;
+
+  return request;
+}
+
+/**
+ * Frees a request once the bus has reported it, then passes the report on
+ * to the caller's callback, which may queue the next transaction.
+ */
+void DS1307::finished(I2CRequest *request)
 {
-  Wire.beginTransmission(DS1307_I2C_ADDRESS);
-  Wire.write(val);
-  Wire.endTransmission();
+  uint8_t index = request - DS1307RTC.requests;
+
+  DS1307RTC.queued &= ~_BV(index);
+
+  if (DS1307RTC.callbacks[index])
+    DS1307RTC.callbacks[index](request);
 }
 
 uint8_t DS1307::decToBcd(uint8_t val)
@@ -20,12 +20,27 @@
 #define DS1307RTC_H_
 
 #include <Arduino.h>
-#include <Wire.h>
 #include <inttypes.h>
+#include "I2CBus.h"
 
 #define DS1307_I2C_ADDRESS 0x68
 #define RAM_SIZE 56
+#define DS1307_TIME_REGISTERS 7
+#define DS1307_REGISTERS 64 // Time, control and RAM
+#define DS1307_REQUESTS I2C_QUEUE_SIZE // Transactions queued at once
 
+/**
+ * DS1307 real time clock on the I2C bus. The blocking calls wait for their
+ * transaction to finish, which takes at most I2C_TIMEOUT. The request*() and
+ * send*() calls only queue it and run the callback from I2C.update() when
+ * done. Each transaction takes one of DS1307_REQUESTS requests, so up to
+ * that many can be queued behind each other; only queueing one more waits,
+ * for the oldest to be reported.
+ *
+ * The buffers are shared: the time registers between requestDateTime() and
+ * the blocking calls, and ramBuffer between every RAM transfer. Callers
+ * keep transfers of the same bytes apart, as isBusy() lets them.
+ */
 class DS1307
 {
   public:
@@ -47,17 +62,37 @@ class DS1307
     void begin();
     void setDateTime(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, 
         uint8_t, bool, bool, bool, uint8_t);
-    void getDateTime(uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, 
+    bool getDateTime(uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, 
         uint8_t*, bool*, bool*);
-    void saveRamData(uint8_t);
-    void getRamData(uint8_t);
+    bool saveRamData(uint8_t);
+    bool getRamData(uint8_t);
+    bool getRamRange(uint8_t, uint8_t);
     bool isRunning();
+    bool readRegisters(uint8_t*);
     uint8_t ramBuffer[RAM_SIZE];
+
+    // Asynchronous
+    bool requestDateTime(I2CCallback);
+    void readDateTime(uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, 
+        uint8_t*, bool*, bool*);
+    bool requestRamData(uint8_t, I2CCallback);
+    bool requestRamRange(uint8_t, uint8_t, I2CCallback);
+    bool sendRamData(uint8_t, I2CCallback);
+    bool sendRamRange(uint8_t, uint8_t, I2CCallback);
+    bool isBusy();
+    uint8_t wait();
     
   private:
+    I2CRequest requests[DS1307_REQUESTS];
+    I2CCallback callbacks[DS1307_REQUESTS];
+    uint8_t queued; // Bit per request not yet reported
+    uint8_t last; // The request queued last
+    uint8_t registers[DS1307_TIME_REGISTERS + 1]; // Time and control
     uint8_t decToBcd(uint8_t);
     uint8_t bcdToDec(uint8_t);
-    void setRegisterPointer(uint8_t val);
+    I2CRequest *submit(uint8_t, uint8_t*, uint8_t, bool, I2CCallback);
+    uint8_t wait(I2CRequest*);
+    static void finished(I2CRequest*);
 };
 
 extern DS1307 DS1307RTC;
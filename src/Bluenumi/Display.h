@@ -20,12 +20,19 @@
 
 #include <Arduino.h>
 #include <inttypes.h>
+#include "FastPin.h"
 
 #define DATA_PIN 13
 #define LATCH_PIN 12
 #define CLK_PIN 11
 #define OE_PIN 7
 
+#define FRAME_MEASURE_COUNT 64 // Frames to average over in measureFrameCycles
+
+#define DISPLAY_BRIGHTNESS_LEVELS 32 // Full brightness; 0 is dark
+#define DISPLAY_RAMP_INTERVAL 40 // ms per brightness level when ramping
+#define DIM_MEASURE_COUNT 64 // Ticks to average over in measureDimCycles
+
 /**
  * Display segment mapping is as follows:
  *
@@ -48,6 +55,27 @@
  * BIT 6 = C
  * BIT 7 = DP
  *
+ * Frames can be shifted out either through Arduino's shiftOut/digitalWrite
+ * (SHIFT_OUT, slow, kept for comparison) or through FastPin, which writes
+ * the port bits directly (DIRECT_PORT, the default). Hardware SPI is not an
+ * option on this board: DATA and CLK are wired to SCK and MOSI the wrong way
+ * round for it, and LATCH sits on MISO, which the SPI master forces to an
+ * input.
+ *
+ * Callers build a frame in the back buffer, either all at once with the
+ * output*() calls or byte by byte with setByte()/setDigit() and commit().
+ * A frame only goes out to the shift registers when it differs from the one
+ * they already hold, and OE_PIN is only written when the enabled state
+ * changes.
+ *
+ * Below full brightness the tubes are dimmed by pulsing OE_PIN from the
+ * Timer0 compare B interrupt, which fires once per Timer0 period (about
+ * 1 kHz). Each tick adds the brightness to an accumulator and turns the
+ * tubes on for that tick when it overflows DISPLAY_BRIGHTNESS_LEVELS, so the
+ * on ticks are spread as evenly as possible. The interrupt is only enabled
+ * while dimming; at full brightness, when dark or when disabled, OE_PIN is
+ * held steady. setBrightness() ramps towards the new level one step every
+ * DISPLAY_RAMP_INTERVAL ms as long as update() is called.
  */
 
 class SegmentDisplay
@@ -62,20 +90,53 @@ class SegmentDisplay
       M     = 0b01111001, //0b00110101, lower case M looks a bit weird
       DASH  = 0b00000100
     };
+
+    enum Backend
+    {
+      SHIFT_OUT,
+      DIRECT_PORT
+    };
     
     SegmentDisplay();
     void begin();
     void outputTime(uint8_t, uint8_t);
     void outputDigits(uint8_t, uint8_t, uint8_t, uint8_t);
     void outputBytes(uint8_t, uint8_t, uint8_t, uint8_t);
+    void setByte(uint8_t, uint8_t);
+    void setDigit(uint8_t, uint8_t);
+    void commit();
     void setEnabled(bool);
     bool getEnabled();
+    void setBrightness(uint8_t);
+    uint8_t getBrightness();
+    uint8_t getTargetBrightness();
+    void update();
+    void dimTick();
+    uint8_t measureDimCycles();
+    void setBackend(enum Backend);
+    uint16_t measureFrameCycles();
+    unsigned long getFramesRequested();
+    unsigned long getFramesPushed();
     uint8_t mapBcd(uint8_t);
 
   private:
     static uint8_t bcdMap[10];
+    void push();
+    void updateOutput();
     void shift(uint8_t);
+    inline void shiftPort(uint8_t);
     bool enabled;
+    bool enabledValid; // OE_PIN has been written
+    volatile uint8_t brightness; // Level dimTick is pulsing OE_PIN at
+    uint8_t targetBrightness;
+    uint8_t dimAccumulator;
+    unsigned long lastRampTime;
+    enum Backend backend;
+    uint8_t back[4]; // Frame being built
+    uint8_t frame[4]; // Frame in the shift registers
+    bool frameValid; // The shift registers hold frame
+    unsigned long framesRequested;
+    unsigned long framesPushed;
 };
 
 extern SegmentDisplay Display;
@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "EventQueue.h"
+
+EventQueue::EventQueue()
+{
+  head = 0;
+  tail = 0;
+}
+
+/**
+ * Called from the main loop. Takes the oldest event, if any, and records how
+ * long it waited.
+ */
+bool EventQueue::pop(Event *event)
+{
+  if (head == tail)
+    return false;
+
+  EVENT_QUEUE_BARRIER();
+  *event = events[head & EVENT_QUEUE_MASK];
+  EVENT_QUEUE_BARRIER();
+  head++;
+
+  maxLatency = max(maxLatency, micros() - event->time);
+
+  return true;
+}
+
+uint16_t EventQueue::getOverflows()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t count = overflows;
+  SREG = oldSREG;
+
+  return count;
+}
+
+uint8_t EventQueue::getMaxDepth()
+{
+  return maxDepth;
+}
+
+/**
+ * Longest time from an event being pushed to it being popped, in us.
+ */
+unsigned long EventQueue::getMaxLatency()
+{
+  return maxLatency;
+}
+
+void EventQueue::resetStats()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  overflows = 0;
+  maxDepth = 0;
+  SREG = oldSREG;
+
+  maxLatency = 0;
+}
+
+EventQueue Events = EventQueue();
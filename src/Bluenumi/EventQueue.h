@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef EVENTQUEUE_H_
+#define EVENTQUEUE_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define EVENT_QUEUE_SIZE 16 // Must be a power of two
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE - 1)
+
+// Keeps the compiler from moving event accesses past an index update
+#define EVENT_QUEUE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+enum EventType
+{
+  EVENT_RTC_TICK = 0,
+  EVENT_TIME_DOWN,
+  EVENT_TIME_UP,
+  EVENT_ALARM_DOWN,
+  EVENT_ALARM_UP
+};
+
+struct Event
+{
+  uint8_t type;
+  unsigned long time; // micros() when the ISR saw it
+};
+
+/**
+ * Single producer, single consumer ring buffer of timestamped events. The
+ * PCINT2 interrupt pushes and the main loop pops, in order. Each side only
+ * writes its own index, and a one byte index is written atomically, so
+ * neither side needs to disable interrupts. Events that don't fit are
+ * dropped and counted.
+ */
+class EventQueue
+{
+  public:
+    EventQueue();
+    inline bool push(uint8_t, unsigned long);
+    bool pop(Event*);
+    uint16_t getOverflows();
+    uint8_t getMaxDepth();
+    unsigned long getMaxLatency();
+    void resetStats();
+
+  private:
+    Event events[EVENT_QUEUE_SIZE];
+    volatile uint8_t head; // Written by the consumer only
+    volatile uint8_t tail; // Written by the producer only
+    volatile uint16_t overflows;
+    volatile uint8_t maxDepth;
+    unsigned long maxLatency;
+};
+
+extern EventQueue Events;
+
+/**
+ * Called from the ISR, and inline so that the ISR calls nothing else.
+ * Returns false if the queue is full.
+ */
+inline bool EventQueue::push(uint8_t type, unsigned long time)
+{
+  uint8_t depth = tail - head;
+
+  if (depth >= EVENT_QUEUE_SIZE)
+  {
+    overflows++;
+    return false;
+  }
+
+  Event *event = &events[tail & EVENT_QUEUE_MASK];
+  event->type = type;
+  event->time = time;
+
+  EVENT_QUEUE_BARRIER();
+  tail++;
+
+  if (depth >= maxDepth)
+    maxDepth = depth + 1;
+
+  return true;
+}
+
+#endif // EVENTQUEUE_H_
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef FASTPIN_H_
+#define FASTPIN_H_
+
+#include <avr/io.h>
+#include <inttypes.h>
+
+/**
+ * An ATmega328P pin chosen at compile time. Arduino pins 0-7 are PORTD,
+ * 8-13 PORTB and 14-19 PORTC, so the port and bit fold away and each call
+ * compiles to a single sbi, cbi or sbic/sbis, where digitalWrite and
+ * digitalRead look the pin up in flash tables every time. Being single
+ * instructions, writes are also safe against ISRs writing other bits of the
+ * same port.
+ *
+ * Unlike digitalWrite, writes don't disconnect a timer's PWM output from
+ * the pin; code that mixes the two has to do that itself. On the host the
+ * port registers are the simulated board's, so the same code runs there.
+ */
+template <uint8_t PIN>
+class FastPin
+{
+  static_assert(PIN < 20, "the ATmega328P has no such pin");
+
+  public:
+    static constexpr uint8_t BIT = _BV(PIN < 8 ? PIN : PIN < 14 ? PIN - 8 : PIN - 14);
+
+    static inline void high()
+    {
+      if (PIN < 8)
+        PORTD |= BIT;
+      else if (PIN < 14)
+        PORTB |= BIT;
+      else
+        PORTC |= BIT;
+    }
+
+    static inline void low()
+    {
+      if (PIN < 8)
+        PORTD &= ~BIT;
+      else if (PIN < 14)
+        PORTB &= ~BIT;
+      else
+        PORTC &= ~BIT;
+    }
+
+    static inline void write(bool value)
+    {
+      if (value)
+        high();
+      else
+        low();
+    }
+
+    // Writing a one to a PINx bit toggles the output
+    static inline void toggle()
+    {
+      if (PIN < 8)
+        PIND = BIT;
+      else if (PIN < 14)
+        PINB = BIT;
+      else
+        PINC = BIT;
+    }
+
+    static inline bool read()
+    {
+      if (PIN < 8)
+        return PIND & BIT;
+      else if (PIN < 14)
+        return PINB & BIT;
+      else
+        return PINC & BIT;
+    }
+};
+
+#endif // FASTPIN_H_
@@ -0,0 +1,300 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <avr/interrupt.h>
+#include <util/twi.h>
+
+#include "I2CBus.h"
+#include "FastPin.h"
+#include "IsrProfiler.h"
+
+#define QUEUE_MASK (I2C_QUEUE_SIZE - 1)
+
+I2CBus::I2CBus()
+{
+  head = 0;
+  current = 0;
+  tail = 0;
+}
+
+void I2CBus::begin()
+{
+  // Internal pull-ups, as the Wire library uses
+  pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+  pinMode(I2C_SCL_PIN, INPUT_PULLUP);
+
+  // A slave may still be stuck in a transfer the last reset interrupted
+  if (!FastPin<I2C_SDA_PIN>::read())
+    recover();
+
+  TWSR = 0;
+  TWBR = ((F_CPU / I2C_FREQUENCY) - 16) / 2;
+  TWCR = _BV(TWEN);
+}
+
+/**
+ * Queues a request, starting it right away if the bus is idle. Returns false
+ * if the queue is full.
+ */
+bool I2CBus::submit(I2CRequest *request)
+{
+  if (request->read && request->length == 0)
+    return false;
+
+  uint8_t oldSREG = SREG;
+  cli();
+
+  if ((uint8_t) (tail - head) >= I2C_QUEUE_SIZE)
+  {
+    SREG = oldSREG;
+    return false;
+  }
+
+  request->status = I2C_STATUS_PENDING;
+  queue[tail & QUEUE_MASK] = request;
+  transactions++;
+
+  if (current == tail++)
+    start();
+
+  SREG = oldSREG;
+  return true;
+}
+
+/**
+ * Blocks until a request has finished and been reported. A stuck bus can't
+ * hang the caller, since the request times out.
+ */
+uint8_t I2CBus::wait(I2CRequest *request)
+{
+  while (request->status == I2C_STATUS_PENDING)
+  {
+    update();
+    delayMicroseconds(I2C_POLL_MICROS);
+  }
+
+  update();
+
+  return request->status;
+}
+
+void I2CBus::update()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+
+  if (current != tail && millis() - startTime > I2C_TIMEOUT)
+  {
+    recover();
+    queue[current++ & QUEUE_MASK]->status = I2C_STATUS_TIMEOUT;
+    timeouts++;
+
+    if (current != tail)
+      start();
+  }
+
+  SREG = oldSREG;
+
+  // Report in submission order; callbacks may submit new requests
+  while (head != current)
+  {
+    I2CRequest *request = queue[head++ & QUEUE_MASK];
+
+    if (request->callback)
+      request->callback(request);
+  }
+}
+
+bool I2CBus::isIdle()
+{
+  return head == tail;
+}
+
+/**
+ * Advances the request on the bus by one step of the TWI state machine.
+ */
+void I2CBus::handleInterrupt()
+{
+  I2CRequest *request = queue[current & QUEUE_MASK];
+
+  switch (TW_STATUS)
+  {
+    case TW_START:
+      TWDR = (request->address << 1) | TW_WRITE;
+      reply(false);
+      break;
+
+    case TW_REP_START:
+      TWDR = (request->address << 1) | TW_READ;
+      reply(false);
+      break;
+
+    case TW_MT_SLA_ACK:
+      TWDR = request->reg;
+      reply(false);
+      break;
+
+    case TW_MT_DATA_ACK:
+      if (request->read)
+      {
+        // Register pointer is set, turn around to read
+        TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTA);
+      }
+      else if (index < request->length)
+      {
+        TWDR = request->data[index++];
+        reply(false);
+      }
+      else
+      {
+        finish(I2C_STATUS_OK);
+      }
+      break;
+
+    case TW_MR_SLA_ACK:
+      // NACK the last byte to tell the slave the read is over
+      reply(request->length > 1);
+      break;
+
+    case TW_MR_DATA_ACK:
+      request->data[index++] = TWDR;
+      reply(index + 1 < request->length);
+      break;
+
+    case TW_MR_DATA_NACK:
+      request->data[index++] = TWDR;
+      finish(I2C_STATUS_OK);
+      break;
+
+    case TW_MT_SLA_NACK:
+    case TW_MR_SLA_NACK:
+    case TW_MT_DATA_NACK:
+      finish(I2C_STATUS_NACK);
+      break;
+
+    default:
+      // Lost arbitration or saw an illegal START/STOP
+      finish(I2C_STATUS_BUS_ERROR);
+      break;
+  }
+}
+
+unsigned long I2CBus::getTransactions()
+{
+  return transactions;
+}
+
+uint16_t I2CBus::getTimeouts()
+{
+  return timeouts;
+}
+
+uint16_t I2CBus::getRecoveries()
+{
+  return recoveries;
+}
+
+uint16_t I2CBus::getErrors()
+{
+  return errors;
+}
+
+void I2CBus::start()
+{
+  // Give the STOP that ended the last request time to get onto the bus
+  for (uint8_t i = 0; (TWCR & _BV(TWSTO)) && i < 255; i++)
+    ;
+
+  index = 0;
+  startTime = millis();
+  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTA);
+}
+
+void I2CBus::reply(bool ack)
+{
+  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | (ack ? _BV(TWEA) : 0);
+}
+
+/**
+ * Ends the request on the bus with a STOP, chaining a START for the next
+ * request if there is one.
+ */
+void I2CBus::finish(uint8_t status)
+{
+  queue[current++ & QUEUE_MASK]->status = status;
+
+  if (status != I2C_STATUS_OK)
+    errors++;
+
+  if (current != tail)
+  {
+    index = 0;
+    startTime = millis();
+    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTO) | _BV(TWSTA);
+  }
+  else
+  {
+    TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+  }
+}
+
+/**
+ * Takes the pins back from the TWI and clocks SCL until the slave releases
+ * SDA, then sends a STOP by hand. Returns whether the bus is free.
+ */
+bool I2CBus::recover()
+{
+  TWCR = 0;
+  recoveries++;
+
+  pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+  FastPin<I2C_SCL_PIN>::high();
+  pinMode(I2C_SCL_PIN, OUTPUT);
+
+  for (uint8_t i = 0; i < I2C_RECOVERY_CLOCKS && !FastPin<I2C_SDA_PIN>::read(); i++)
+  {
+    FastPin<I2C_SCL_PIN>::low();
+    delayMicroseconds(5);
+    FastPin<I2C_SCL_PIN>::high();
+    delayMicroseconds(5);
+  }
+
+  // STOP: SDA rises while SCL is high
+  FastPin<I2C_SCL_PIN>::low();
+  FastPin<I2C_SDA_PIN>::low();
+  pinMode(I2C_SDA_PIN, OUTPUT);
+  delayMicroseconds(5);
+  FastPin<I2C_SCL_PIN>::high();
+  delayMicroseconds(5);
+  pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+  pinMode(I2C_SCL_PIN, INPUT_PULLUP);
+
+  bool free = FastPin<I2C_SDA_PIN>::read();
+
+  TWCR = _BV(TWEN);
+
+  return free;
+}
+
+ISR(TWI_vect)
+{
+  uint16_t start = Profiler.enter(ISR_TWI);
+  I2C.handleInterrupt();
+  Profiler.exit(ISR_TWI, start);
+}
+
+I2CBus I2C = I2CBus();
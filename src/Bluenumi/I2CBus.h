@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef I2CBUS_H_
+#define I2CBUS_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define I2C_FREQUENCY 100000L
+#define I2C_QUEUE_SIZE 4 // Must be a power of two
+#define I2C_TIMEOUT 10 // ms a transaction may take before the bus is reset
+#define I2C_RECOVERY_CLOCKS 9 // Enough to finish any byte a slave is stuck in
+#define I2C_POLL_MICROS 10 // Busy-wait step for wait()
+
+// The TWI shares its pins with analog inputs 4 and 5
+#define I2C_SDA_PIN 18
+#define I2C_SCL_PIN 19
+
+enum I2CStatus
+{
+  I2C_STATUS_OK = 0,
+  I2C_STATUS_PENDING,
+  I2C_STATUS_NACK,
+  I2C_STATUS_TIMEOUT,
+  I2C_STATUS_BUS_ERROR
+};
+
+struct I2CRequest;
+
+typedef void (*I2CCallback)(I2CRequest*);
+
+/**
+ * A register transaction: reg is written to the slave, then length bytes of
+ * data are either written after it or read back after a repeated start. The
+ * request must stay alive while its status is I2C_STATUS_PENDING.
+ */
+struct I2CRequest
+{
+  uint8_t address;
+  uint8_t reg;
+  uint8_t *data;
+  uint8_t length;
+  bool read;
+  I2CCallback callback; // Run from update() once finished, may be NULL
+  volatile uint8_t status;
+};
+
+/**
+ * Interrupt driven TWI master. Requests are queued and transferred one after
+ * another by the TWI interrupt, so the caller only pays for queueing them.
+ * update() reports finished requests in order through their callbacks and
+ * resets the bus when a transaction takes longer than I2C_TIMEOUT, clocking
+ * out any slave that is holding SDA low.
+ */
+class I2CBus
+{
+  public:
+    I2CBus();
+    void begin();
+    bool submit(I2CRequest*);
+    uint8_t wait(I2CRequest*);
+    void update();
+    bool isIdle();
+    void handleInterrupt();
+    unsigned long getTransactions();
+    uint16_t getTimeouts();
+    uint16_t getRecoveries();
+    uint16_t getErrors();
+
+  private:
+    I2CRequest *queue[I2C_QUEUE_SIZE];
+    volatile uint8_t head; // Oldest request not yet reported
+    volatile uint8_t current; // Request on the bus, unless equal to tail
+    volatile uint8_t tail;
+    uint8_t index;
+    unsigned long startTime;
+    unsigned long transactions; // Requests accepted by submit()
+    uint16_t timeouts;
+    uint16_t recoveries;
+    volatile uint16_t errors;
+    void start();
+    void reply(bool);
+    void finish(uint8_t);
+    bool recover();
+};
+
+extern I2CBus I2C;
+
+#endif // I2CBUS_H_
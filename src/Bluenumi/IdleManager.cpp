@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "IdleManager.h"
+#include "Scheduler.h"
+
+IdleManager::IdleManager()
+{
+  wakePins = 0;
+}
+
+/**
+ * Sets the PORTD pins, as a PCMSK2 mask, that wake the MCU from power-down
+ * besides the square wave.
+ */
+void IdleManager::begin(uint8_t pins)
+{
+  wakePins = pins;
+}
+
+/**
+ * Sleeps until the next interrupt unless a task is already due. Power-down
+ * is only used when asked for and no one-shot task is waiting, since those
+ * are timed by millis().
+ */
+void IdleManager::sleep(bool powerDown)
+{
+  // With interrupts off, nothing can make a task due between the check and
+  // the sleep; sei() takes effect only after the following instruction
+  cli();
+
+  if (Tasks.isDue())
+  {
+    sei();
+    return;
+  }
+
+  unsigned long start = micros();
+
+  powerDown = powerDown && !Tasks.hasPending();
+  set_sleep_mode(powerDown ? SLEEP_MODE_PWR_DOWN : SLEEP_MODE_IDLE);
+  sleep_enable();
+
+  if (powerDown)
+  {
+    PCMSK2 |= wakePins;
+
+    // Must be right before sleeping to take effect
+    sleep_bod_disable();
+  }
+
+  sei();
+  sleep_cpu();
+  sleep_disable();
+
+  if (powerDown)
+  {
+    PCMSK2 &= ~wakePins;
+    powerDowns++;
+    Tasks.catchUp();
+    return;
+  }
+
+  sleeps++;
+  idleMicros += micros() - start;
+
+  while (idleMicros >= 1000)
+  {
+    idleMicros -= 1000;
+    idleMillis++;
+  }
+}
+
+unsigned long IdleManager::getSleeps()
+{
+  return sleeps;
+}
+
+unsigned long IdleManager::getPowerDowns()
+{
+  return powerDowns;
+}
+
+unsigned long IdleManager::getIdleMillis()
+{
+  return idleMillis;
+}
+
+IdleManager Idle = IdleManager();
@@ -0,0 +1,58 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef IDLEMANAGER_H_
+#define IDLEMANAGER_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+/**
+ * Puts the MCU to sleep from loop() whenever no task is due.
+ *
+ * Idle sleep stops only the CPU: Timer0 keeps millis() going and wakes it
+ * at least every 1.024 ms, as do the audio and display compare interrupts,
+ * the RTC square wave and TWI, so the next task never starts late.
+ *
+ * Power-down also stops Timer0, leaving only pin changes to wake it: the
+ * RTC square wave, plus the wake pins given to begin() for the length of
+ * the sleep. millis() stands still meanwhile, so on waking every periodic
+ * task is made due at once. The caller decides when that is safe.
+ */
+class IdleManager
+{
+  public:
+    IdleManager();
+    void begin(uint8_t);
+    void sleep(bool);
+    unsigned long getSleeps();
+    unsigned long getPowerDowns();
+    unsigned long getIdleMillis();
+
+  private:
+    uint8_t wakePins; // PCMSK2 bits added during power-down
+
+    // Statistics
+    unsigned long sleeps;
+    unsigned long powerDowns;
+    unsigned long idleMillis; // Time in idle sleep
+    uint16_t idleMicros; // Part of a ms not yet in idleMillis
+};
+
+extern IdleManager Idle;
+
+#endif // IDLEMANAGER_H_
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "InputRecorder.h"
+
+// Only built in when recording, since the trace takes a quarter of the RAM
+#if INPUT_TRACE
+
+// Not cleared at startup, so a reset leaves the last session for dump()
+InputTrace InputRecorder::trace __attribute__((section(".noinit")));
+
+InputRecorder::InputRecorder()
+{
+  recording = false;
+}
+
+/**
+ * Starts a new trace of the given PIND bits, and enables their pin change
+ * interrupts so that every change is seen. The first transition is the
+ * state they start in.
+ */
+void InputRecorder::begin(uint8_t pins)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+
+  trace.magic = INPUT_TRACE_MAGIC;
+  trace.count = 0;
+  trace.dropped = 0;
+  memset(trace.registers, 0, sizeof(trace.registers));
+
+  trace.pinMask = pins;
+  lastPins = ~pins; // Matches no state, so the next sample is recorded
+  recording = true;
+  record(PIND, false);
+
+  PCMSK2 |= pins;
+
+  SREG = oldSREG;
+}
+
+/**
+ * Keeps the DS1307's registers, time and RAM, as the firmware found them.
+ * Called before anything writes to it.
+ */
+void InputRecorder::saveRegisters()
+{
+  DS1307RTC.readRegisters(trace.registers);
+}
+
+/**
+ * Prints the trace, if RAM holds one, on the serial port: a header line,
+ * the registers and the recorded pins in hex, the count of transitions
+ * dropped, then "second offset pins" for each transition.
+ */
+void InputRecorder::dump()
+{
+  if (trace.magic != INPUT_TRACE_MAGIC || trace.count > INPUT_TRACE_SIZE)
+    return;
+
+  Serial.begin(INPUT_TRACE_BAUD);
+  Serial.println("BLUENUMI TRACE");
+  Serial.print("R ");
+
+  for (uint8_t i = 0; i < DS1307_REGISTERS; i++)
+  {
+    if (trace.registers[i] < 0x10)
+      Serial.print('0');
+
+    Serial.print(trace.registers[i], HEX);
+  }
+
+  Serial.println();
+  Serial.print("M ");
+  Serial.println(trace.pinMask, HEX);
+  Serial.print("D ");
+  Serial.println(trace.dropped);
+
+  for (uint16_t i = 0; i < trace.count; i++)
+  {
+    const InputTransition *transition = &trace.transitions[i];
+    Serial.print(transition->second);
+    Serial.print(' ');
+    Serial.print(transition->offset);
+    Serial.print(' ');
+    Serial.println(transition->pins, HEX);
+  }
+
+  Serial.println("END");
+  Serial.end();
+}
+
+InputRecorder Recorder = InputRecorder();
+
+#endif // INPUT_TRACE
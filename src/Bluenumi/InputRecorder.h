@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef INPUTRECORDER_H_
+#define INPUTRECORDER_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "DS1307RTC.h"
+
+// Set to 1 to record the buttons against the RTC square wave, for replay in
+// the simulator. Recording keeps a trace's worth of RAM to itself; with 0,
+// the recorder and its trace aren't built at all.
+#ifndef INPUT_TRACE
+#define INPUT_TRACE 0
+#endif
+
+#define INPUT_TRACE_SIZE 96 // Button transitions kept, 5 bytes each
+#define INPUT_TRACE_MAGIC 0x7E5A
+#define INPUT_TRACE_BAUD 9600
+
+/**
+ * One change of the button pins. It happened offset ms after the later of
+ * the previous transition and square wave tick number second, counting
+ * ticks from power-up.
+ */
+struct InputTransition
+{
+  uint16_t second;
+  uint16_t offset; // Saturates after a minute with neither
+  uint8_t pins; // The button bits of PIND after the change
+};
+
+struct InputTrace
+{
+  uint16_t magic;
+  uint8_t pinMask; // PIND bits recorded
+  uint8_t registers[DS1307_REGISTERS]; // The DS1307 as it was at power-up
+  uint16_t count;
+  uint16_t dropped; // Transitions that came after the trace filled up
+  InputTransition transitions[INPUT_TRACE_SIZE];
+};
+
+/**
+ * Records every change of the button pins, bounces included, from the pin
+ * change interrupt, timed from the last RTC square wave tick rather than
+ * by millis() alone, so the order of presses and ticks survives the two
+ * clocks drifting apart. Together with the DS1307's registers at power-up,
+ * that is everything from outside the firmware, and the simulator's
+ * --replay runs the firmware through the same session (see README).
+ *
+ * The trace sits in RAM that the C runtime leaves alone, so it survives a
+ * reset, such as the one a USB serial adapter gives when it is plugged in.
+ * dump() prints it on the serial port at the next power-up, before begin()
+ * starts a new one. Recording stops when the trace is full.
+ *
+ * In power-down millis() stands still, so a button that wakes the clock
+ * is recorded as pressed on the tick before it.
+ */
+class InputRecorder
+{
+  public:
+    InputRecorder();
+    void begin(uint8_t);
+    void saveRegisters();
+    inline void record(uint8_t, bool);
+    void dump();
+
+  private:
+    static InputTrace trace;
+    uint8_t lastPins;
+    bool recording;
+    uint16_t seconds; // Ticks since power-up
+    unsigned long lastMillis; // Of the last tick or transition
+};
+
+extern InputRecorder Recorder;
+
+/**
+ * Called from the pin change interrupt with the port it read and whether
+ * the square wave just ticked.
+ */
+inline void InputRecorder::record(uint8_t pind, bool tick)
+{
+  if (tick)
+  {
+    seconds++;
+    lastMillis = millis();
+  }
+
+  uint8_t pins = pind & trace.pinMask;
+
+  if (!recording || pins == lastPins)
+    return;
+
+  lastPins = pins;
+
+  if (trace.count == INPUT_TRACE_SIZE)
+  {
+    trace.dropped++;
+    return;
+  }
+
+  unsigned long now = millis();
+  InputTransition *transition = &trace.transitions[trace.count++];
+  transition->second = seconds;
+  transition->offset = min(now - lastMillis, 0xFFFFUL);
+  transition->pins = pins;
+  lastMillis = now;
+}
+
+#endif // INPUTRECORDER_H_
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "IsrProfiler.h"
+
+static_assert((ISR_CYCLE_MASK & (ISR_CYCLE_MASK + 1)) == 0,
+    "Timer1's TOP must be one less than a power of two to mask cycle counts");
+
+IsrProfiler::IsrProfiler()
+{
+  running = false;
+  depth = 0;
+}
+
+/**
+ * Starts recording, once Timer1 counts CPU cycles. Entries before this are
+ * not counted.
+ */
+void IsrProfiler::begin()
+{
+  resetStats();
+
+  uint8_t oldSREG = SREG;
+  cli();
+  running = true;
+  SREG = oldSREG;
+}
+
+/**
+ * Copies one handler's figures, consistently, into stats.
+ */
+void IsrProfiler::getStats(uint8_t id, IsrStats *stats)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  stats->entries = entries[id];
+  stats->maxCycles = maxCycles[id];
+  stats->meanCycles = cycleSamples[id] ? cycleSums[id] / cycleSamples[id] : 0;
+  stats->nested = nested[id];
+  SREG = oldSREG;
+}
+
+/**
+ * Longest run, in CPU cycles, of a handler that ended with a pin change
+ * interrupt pending. The pin change waited no longer than that.
+ */
+uint16_t IsrProfiler::getMaxPinChangeBlock()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t value = maxPinChangeBlock;
+  SREG = oldSREG;
+
+  return value;
+}
+
+void IsrProfiler::resetStats()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+
+  for (uint8_t i = 0; i < NUM_PROFILED_ISRS; i++)
+  {
+    entries[i] = 0;
+    cycleSums[i] = 0;
+    cycleSamples[i] = 0;
+    maxCycles[i] = 0;
+    nested[i] = 0;
+  }
+
+  maxPinChangeBlock = 0;
+  SREG = oldSREG;
+}
+
+IsrProfiler Profiler = IsrProfiler();
@@ -0,0 +1,140 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef ISRPROFILER_H_
+#define ISRPROFILER_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "LEDController.h"
+
+// Set to 0 to compile the instrumentation out of the interrupt handlers
+#define ISR_PROFILE 1
+
+// Timer1 counts CPU cycles up to LED_PWM_TOP and wraps, so differences of
+// its count, masked, are cycle counts for anything under 1.024 ms
+#define ISR_CYCLE_MASK LED_PWM_TOP
+
+#define ISR_MEAN_WINDOW 1024 // Entries after which the running mean is halved
+
+enum IsrId
+{
+  ISR_PCINT2 = 0, // RTC square wave, and the buttons during power-down
+  ISR_TIMER0_COMPA, // Audio
+  ISR_TIMER0_COMPB, // Display dimming
+  ISR_TWI,
+  NUM_PROFILED_ISRS
+};
+
+struct IsrStats
+{
+  unsigned long entries;
+  uint16_t maxCycles;
+  uint16_t meanCycles;
+  uint16_t nested; // Entries while another profiled handler was running
+};
+
+/**
+ * Counts and times the interrupt handlers. Each handler calls enter() first
+ * and exit() last, which read Timer1, running at the CPU clock for the
+ * underlights, so the cycles between the two are exact. The handler's
+ * register saves, restores and reti come on top: a few cycles for a handler
+ * that calls nothing, 30 to 40 for one that does.
+ *
+ * A pin change that arrives while another handler runs waits for it to
+ * finish. exit() notices the pin change flag still raised and records how
+ * long the handler ran. Nothing records when the edge itself came, so
+ * getMaxPinChangeBlock() is an upper bound on how long the RTC tick and
+ * wake-up buttons have waited behind a handler, not the wait itself. The
+ * (short) sections of the main loop that disable interrupts aren't seen.
+ *
+ * Timer1 is only counting CPU cycles once the LEDs have begun, so begin()
+ * has to come after that.
+ */
+class IsrProfiler
+{
+  public:
+    IsrProfiler();
+    void begin();
+    inline uint16_t enter(uint8_t);
+    inline void exit(uint8_t, uint16_t);
+    void getStats(uint8_t, IsrStats*);
+    uint16_t getMaxPinChangeBlock();
+    void resetStats();
+
+  private:
+    bool running;
+    volatile uint8_t depth; // Profiled handlers currently running
+    unsigned long entries[NUM_PROFILED_ISRS];
+    uint32_t cycleSums[NUM_PROFILED_ISRS];
+    uint16_t cycleSamples[NUM_PROFILED_ISRS];
+    uint16_t maxCycles[NUM_PROFILED_ISRS];
+    uint16_t nested[NUM_PROFILED_ISRS];
+    uint16_t maxPinChangeBlock; // Longest handler run with a pin change pending
+};
+
+extern IsrProfiler Profiler;
+
+/**
+ * Called first thing in a handler. Returns the start time to pass to exit().
+ */
+inline uint16_t IsrProfiler::enter(uint8_t id)
+{
+#if ISR_PROFILE
+  uint16_t start = TCNT1;
+
+  if (depth++)
+    nested[id]++;
+
+  return start;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Called last thing in a handler, with interrupts still disabled.
+ */
+inline void IsrProfiler::exit(uint8_t id, uint16_t start)
+{
+#if ISR_PROFILE
+  depth--;
+
+  if (!running)
+    return;
+
+  uint16_t cycles = (TCNT1 - start) & ISR_CYCLE_MASK;
+
+  entries[id]++;
+  cycleSums[id] += cycles;
+
+  // Halving both keeps the mean while weighting recent entries
+  if (++cycleSamples[id] == ISR_MEAN_WINDOW)
+  {
+    cycleSums[id] >>= 1;
+    cycleSamples[id] >>= 1;
+  }
+
+  if (cycles > maxCycles[id])
+    maxCycles[id] = cycles;
+
+  if (id != ISR_PCINT2 && (PCIFR & _BV(PCIF2)) && cycles > maxPinChangeBlock)
+    maxPinChangeBlock = cycles;
+#endif
+}
+
+#endif // ISRPROFILER_H_
@@ -16,30 +16,110 @@
  ******************************************************************************/
 
 #include "LEDController.h"
+#include "FastPin.h"
+
+static constexpr uint8_t ledPins[NUM_LED_TRACKS] PROGMEM = {
+  SECONDS0_PIN, SECONDS1_PIN, SECONDS2_PIN, SECONDS3_PIN
+};
+
+/**
+ * Pattern levels are perceived brightness. The CIE 1931 lightness curve
+ * turns them into PWM duty in LED_PWM_TOP units, worked out at compile
+ * time; the dim end gets steps far finer than 8-bit PWM can make.
+ */
+static constexpr double cieLuminance(double lightness)
+{
+  return lightness <= 8.0 ? lightness / 903.3 :
+      ((lightness + 16.0) / 116.0) * ((lightness + 16.0) / 116.0) * ((lightness + 16.0) / 116.0);
+}
+
+static constexpr uint16_t gammaEntry(int i)
+{
+  return cieLuminance(i * 100.0 / 255.0) * LED_PWM_TOP + 0.5;
+}
+
+#define GAMMA_4(i) gammaEntry(i), gammaEntry(i + 1), gammaEntry(i + 2), gammaEntry(i + 3)
+#define GAMMA_16(i) GAMMA_4(i), GAMMA_4(i + 4), GAMMA_4(i + 8), GAMMA_4(i + 12)
+#define GAMMA_64(i) GAMMA_16(i), GAMMA_16(i + 16), GAMMA_16(i + 32), GAMMA_16(i + 48)
+
+static constexpr uint16_t gammaTable[256] PROGMEM = {
+  GAMMA_64(0), GAMMA_64(64), GAMMA_64(128), GAMMA_64(192)
+};
+
+static_assert(gammaTable[255] == LED_PWM_TOP, "gamma table must reach full brightness");
 
 LEDController::LEDController()
 {
-  mapHandlers();
 }
 
 void LEDController::begin()
 {
   enabled = true;
   paused = false;
-  currentType = ROLLING_BREATHE;
+  setPattern(&ROLLING_BREATHE_PATTERN);
+  resync = true;
   
   pinMode(SECONDS0_PIN, OUTPUT);
   pinMode(SECONDS1_PIN, OUTPUT);
   pinMode(SECONDS2_PIN, OUTPUT);
   pinMode(SECONDS3_PIN, OUTPUT);
+
+  // Timer1: fast PWM with TOP in ICR1 (mode 14), no prescaling. The
+  // outputs are connected at the first frame.
+  TCCR1A = _BV(WGM11);
+  TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS10);
+  ICR1 = LED_PWM_TOP;
 }
 
-void LEDController::update()
+/**
+ * Draws the frame that was due at the given time. Frame times the previous
+ * update skipped count as missed; a frame drawn more than LED_FRAME_LATE ms
+ * after its time counts as late.
+ */
+void LEDController::update(unsigned long due)
 {
   if (!enabled || paused)
+  {
+    hold();
     return;
+  }
+
+  unsigned long now = millis();
+
+  if (resync)
+  {
+    resync = false;
+    lastDue = due;
+    lastFrame = now;
+  }
+
+  unsigned long elapsed = due - lastDue;
+
+  // Divide only after a stall
+  if (elapsed > LED_FRAME_PERIOD)
+    missedFrames += elapsed / LED_FRAME_PERIOD - 1;
+
+  if (now - due > LED_FRAME_LATE)
+    lateFrames++;
 
-  CALL_MEMBER_FN(this, patternHandlerMap[currentType])();
+  longestGap = max(longestGap, now - lastFrame);
+  lastDue = due;
+  lastFrame = now;
+  frames++;
+
+  // Wraps modulo the pattern's period, so long gaps are harmless
+  player.advance(elapsed);
+  draw();
+}
+
+/**
+ * Stands in for update() while the LEDs show something other than the
+ * pattern: the pattern stops where it is, and the time until the next
+ * update counts neither as missed frames nor as a gap.
+ */
+void LEDController::hold()
+{
+  resync = true;
 }
 
 void LEDController::pause()
@@ -52,6 +132,15 @@ void LEDController::resume()
   paused = false;
 }
 
+/**
+ * Switches to a pattern in flash (see LEDPattern.h), from its beginning.
+ */
+void LEDController::setPattern(const LEDPattern *pattern)
+{
+  player.start(pattern);
+  redraw = true;
+}
+
 void LEDController::setEnabled(bool value)
 {
   enabled = value;
@@ -60,40 +149,167 @@ void LEDController::setEnabled(bool value)
 
 void LEDController::setLEDStates(bool led0, bool led1, bool led2, bool led3)
 {
-  digitalWrite(SECONDS0_PIN, led0);
-  digitalWrite(SECONDS1_PIN, led1);
-  digitalWrite(SECONDS2_PIN, led2);
-  digitalWrite(SECONDS3_PIN, led3);
+  // Take the pins back from the timers, as digitalWrite would; the next
+  // frame must then write every pin
+  TCCR0A &= ~(_BV(COM0A1) | _BV(COM0B1));
+  TCCR1A &= ~(_BV(COM1A1) | _BV(COM1B1));
+  redraw = true;
+
+  FastPin<SECONDS0_PIN>::write(led0);
+  FastPin<SECONDS1_PIN>::write(led1);
+  FastPin<SECONDS2_PIN>::write(led2);
+  FastPin<SECONDS3_PIN>::write(led3);
 }
 
-void LEDController::mapHandlers()
+/**
+ * Sets the LEDs to a fixed pattern UPDATE_MEASURE_COUNT times, through
+ * setLEDStates or, for comparison, through digitalWrite, and returns the
+ * average cost of one call in CPU cycles, interrupts included. Only
+ * meaningful on the hardware.
+ */
+uint16_t LEDController::measureStateCycles(bool arduino)
 {
-  patternHandlerMap[BREATHE] = &LEDController::breatheHandler;
-  patternHandlerMap[ROLLING_BREATHE] = &LEDController::rollingBreatheHandler;
+  unsigned long start = micros();
+
+  for (uint8_t i = 0; i < UPDATE_MEASURE_COUNT; i++)
+  {
+    bool on = i & 1;
+
+    if (arduino)
+    {
+      digitalWrite(SECONDS0_PIN, on);
+      digitalWrite(SECONDS1_PIN, on);
+      digitalWrite(SECONDS2_PIN, on);
+      digitalWrite(SECONDS3_PIN, on);
+    }
+    else
+    {
+      setLEDStates(on, on, on, on);
+    }
+  }
+
+  unsigned long elapsed = micros() - start;
+
+  return elapsed * (F_CPU / 1000000L) / UPDATE_MEASURE_COUNT;
 }
 
-void LEDController::breatheHandler()
+/**
+ * Returns the PWM duty, out of LED_PWM_TOP, for a perceived brightness.
+ */
+uint16_t LEDController::toDuty(uint8_t level)
 {
-  float val = calculateBreatheVal(PI/2.0, 0.0, 4000);
-  analogWrite(SECONDS0_PIN, val);
-  analogWrite(SECONDS1_PIN, val);
-  analogWrite(SECONDS2_PIN, val);
-  analogWrite(SECONDS3_PIN, val);
+  return pgm_read_word(&gammaTable[level]);
 }
 
-void LEDController::rollingBreatheHandler()
+/**
+ * Draws UPDATE_MEASURE_COUNT frames and returns the average cost of one in
+ * CPU cycles, interrupts included. Only meaningful on the hardware.
+ */
+uint16_t LEDController::measureUpdateCycles()
 {
-  float freqAdj = PI/2.0;
-  analogWrite(SECONDS3_PIN, calculateBreatheVal(freqAdj, 0.0, 4000));
-  analogWrite(SECONDS2_PIN, calculateBreatheVal(freqAdj, PI/4.0, 4000));
-  analogWrite(SECONDS1_PIN, calculateBreatheVal(freqAdj, PI/2.0, 4000)); 
-  analogWrite(SECONDS0_PIN, calculateBreatheVal(freqAdj, 3*PI/4.0, 4000));
+  unsigned long start = micros();
+
+  for (uint8_t i = 0; i < UPDATE_MEASURE_COUNT; i++)
+  {
+    player.advance(LED_FRAME_PERIOD);
+    draw();
+  }
+
+  unsigned long elapsed = micros() - start;
+
+  return elapsed * (F_CPU / 1000000L) / UPDATE_MEASURE_COUNT;
 }
 
-float LEDController::calculateBreatheVal(float frequencyAdjust, float offset, int periodicity)
+unsigned long LEDController::getFrames()
 {
-  float val = (millis() % periodicity) / 1000.0;
-  return (exp(sin(val * frequencyAdjust + offset)) - 0.36787944)*108.0;
+  return frames;
+}
+
+unsigned long LEDController::getUnchangedFrames()
+{
+  return unchangedFrames;
+}
+
+unsigned long LEDController::getLateFrames()
+{
+  return lateFrames;
+}
+
+unsigned long LEDController::getMissedFrames()
+{
+  return missedFrames;
+}
+
+unsigned long LEDController::getLongestGap()
+{
+  return longestGap;
+}
+
+/**
+ * Writes the levels that changed since the last frame. The Timer1 LEDs only
+ * cost a table lookup when their level changes.
+ */
+void LEDController::draw()
+{
+  bool changed = false;
+
+  if (redraw)
+    TCCR1A |= _BV(COM1A1) | _BV(COM1B1);
+
+  uint8_t level = player.getLevel(0);
+
+  if (redraw || level != written[0])
+  {
+    OCR1A = toDuty(level);
+    written[0] = level;
+    changed = true;
+  }
+
+  level = player.getLevel(1);
+
+  if (redraw || level != written[1])
+  {
+    OCR1B = toDuty(level);
+    written[1] = level;
+    changed = true;
+  }
+
+  changed |= drawTimer0(2, player.getLevel(2));
+  changed |= drawTimer0(3, player.getLevel(3));
+  redraw = false;
+
+  if (!changed)
+    unchangedFrames++;
+}
+
+/**
+ * Writes an 8-bit LED, rounding its duty to the nearest PWM step or, with
+ * LED_DITHER, carrying the remainder into the next frame. Returns whether
+ * the pin was written.
+ */
+bool LEDController::drawTimer0(uint8_t led, uint8_t level)
+{
+  // Duty as 8.8 fixed point
+  uint16_t duty = toDuty(level) << (16 - LED_PWM_BITS);
+
+#if LED_DITHER
+  uint16_t sum = dither[led] + (duty & 0xff);
+  uint16_t value = (duty >> 8) + (sum >> 8);
+  dither[led] = sum;
+#else
+  uint16_t value = (duty + 0x80) >> 8;
+#endif
+
+  if (value > 255)
+    value = 255;
+
+  if (!redraw && value == written[led])
+    return false;
+
+  analogWrite(pgm_read_byte(&ledPins[led]), value);
+  written[led] = value;
+
+  return true;
 }
 
 LEDController LEDs = LEDController();
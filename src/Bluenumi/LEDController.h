@@ -20,43 +20,80 @@
 
 #include <Arduino.h>
 #include <inttypes.h>
-#include <math.h>
+#include "LEDPattern.h"
 
 #define SECONDS0_PIN 9 // LED under 10s hour
 #define SECONDS1_PIN 10 // LED under 1s hour
 #define SECONDS2_PIN 6 // LED under 10s minute
 #define SECONDS3_PIN 5 // LED under 1s minute
 
-#define CALL_MEMBER_FN(object, ptrToMember) ((object)->*(ptrToMember))
+// SECONDS0 and SECONDS1 run from Timer1 in fast PWM with ICR1 as TOP, at
+// LED_PWM_BITS of resolution (16 MHz / 2^14 = 977 Hz). SECONDS2 and
+// SECONDS3 share Timer0 with millis() and stay 8-bit.
+#define LED_PWM_BITS 14
+#define LED_PWM_TOP ((1U << LED_PWM_BITS) - 1)
 
+// Set to 1 to dither the 8-bit LEDs from frame to frame, carrying what
+// their PWM can't show into the next frame. Smoother fades, but at the
+// dim end the two levels alternate slowly enough that some eyes see it.
+#define LED_DITHER 0
+
+#define LED_FRAME_RATE 100 // Animation frames per second
+#define LED_FRAME_PERIOD (1000 / LED_FRAME_RATE) // ms
+#define LED_FRAME_LATE (LED_FRAME_PERIOD / 2) // Lateness, in ms, that makes a frame late
+
+#define UPDATE_MEASURE_COUNT 64 // Frames to average over in measureUpdateCycles
+
+/**
+ * Plays an LEDPattern on the four underlighting LEDs, one frame every
+ * LED_FRAME_PERIOD ms from a periodic task. Each frame moves the pattern on
+ * by the frame times rather than the loop's timing, writes only the LEDs
+ * whose level changed, and counts late and missed frames so stalls in the
+ * main loop show up.
+ */
 class LEDController
 {
   public:
-    typedef void (LEDController::*PatternHandler)();
-    enum PatternType
-    {
-      BREATHE,
-      ROLLING_BREATHE
-    };
-
     LEDController();
     void begin();
-    void update();
+    void update(unsigned long);
+    void hold();
     void pause();
     void resume();
-    void setType(enum PatternType);
+    void setPattern(const LEDPattern*);
     void setEnabled(bool);
     void setLEDStates(bool, bool, bool, bool);
+    static uint16_t toDuty(uint8_t);
+    uint16_t measureUpdateCycles();
+    uint16_t measureStateCycles(bool);
+    unsigned long getFrames();
+    unsigned long getUnchangedFrames();
+    unsigned long getLateFrames();
+    unsigned long getMissedFrames();
+    unsigned long getLongestGap();
 
   private:
-    void mapHandlers();
-    enum PatternType currentType;
     bool enabled;
     bool paused;
-    PatternHandler patternHandlerMap[2];
-    void breatheHandler();
-    void rollingBreatheHandler();
-    float calculateBreatheVal(float, float, int);
+    bool resync; // Restart the frame count at the next update
+    bool redraw; // Write every LED at the next frame
+    PatternPlayer player;
+    uint8_t written[NUM_LED_TRACKS]; // Last level, or 8-bit PWM value on Timer0
+#if LED_DITHER
+    uint8_t dither[NUM_LED_TRACKS]; // Fraction of a PWM step carried over
+#endif
+    unsigned long lastDue;
+    unsigned long lastFrame;
+
+    // Statistics
+    unsigned long frames;
+    unsigned long unchangedFrames;
+    unsigned long lateFrames;
+    unsigned long missedFrames;
+    unsigned long longestGap; // ms between two frames
+
+    void draw();
+    bool drawTimer0(uint8_t, uint8_t);
 };
 
 extern LEDController LEDs;
@@ -0,0 +1,242 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "LEDPattern.h"
+
+/**
+ * Adding a pattern
+ *
+ * Write its keyframes as a static constexpr LEDKeyframe array in PROGMEM,
+ * then the LEDPattern itself with TRACK() for each LED, and a
+ * static_assert(patternValid(...)) so a malformed pattern fails to compile.
+ * Tracks may share keyframe arrays. Declare the pattern in LEDPattern.h and
+ * hand it to LEDs.setPattern(); build/led-preview in the host build shows
+ * what it looks like.
+ */
+
+#define TRACK(keys, offset) { keys, sizeof(keys) / sizeof(keys[0]), offset }
+
+static constexpr bool keyframesValid(const LEDKeyframe *keys, uint8_t count,
+    uint16_t period, uint8_t i = 0)
+{
+  return i == count ||
+      ((i == 0 ? keys[i].time == 0 : keys[i].time > keys[i - 1].time) &&
+       keys[i].time < period && keyframesValid(keys, count, period, i + 1));
+}
+
+/**
+ * Every track has keyframes, first at 0 and rising strictly inside the
+ * period, and an offset shorter than the period.
+ */
+static constexpr bool patternValid(const LEDPattern &pattern, uint8_t i = 0)
+{
+  return i == NUM_LED_TRACKS ||
+      (pattern.tracks[i].count > 0 && pattern.tracks[i].offset < pattern.period &&
+       keyframesValid(pattern.tracks[i].keys, pattern.tracks[i].count, pattern.period) &&
+       patternValid(pattern, i + 1));
+}
+
+/**
+ * The breathe curve, (e^sin(x) - 1/e) * 108 over one period, is evaluated at
+ * compile time with Taylor series so no floating point code ends up on the
+ * chip. Angles are folded into [-PI, PI) where 13 terms of sin are plenty.
+ * The curve gives light output, so it is turned into perceived brightness
+ * with the inverse of the CIE lightness curve LEDController applies.
+ * BREATHE_KEYS keyframes spaced evenly over the period keep the ramps within
+ * two steps of the curve.
+ */
+#define BREATHE_PERIOD 4000 // Length of one breath in ms
+#define BREATHE_KEYS 40
+
+static constexpr double taylorSin(double x, double term, double sum, int n)
+{
+  return n > 12 ? sum : taylorSin(x, -term*x*x / ((2*n) * (2*n + 1)), sum + term, n + 1);
+}
+
+static constexpr double taylorExp(double x, double term, double sum, int n)
+{
+  return n > 20 ? sum : taylorExp(x, term*x / n, sum + term, n + 1);
+}
+
+static constexpr double newtonCbrt(double x, double y, int n)
+{
+  return n == 0 ? y : newtonCbrt(x, (2.0*y + x / (y*y)) / 3.0, n - 1);
+}
+
+static constexpr double breatheAngle(int i)
+{
+  return 2.0*PI * (i < BREATHE_KEYS/2 ? i : i - BREATHE_KEYS) / BREATHE_KEYS;
+}
+
+static constexpr double breatheLight(int i)
+{
+  return (taylorExp(taylorSin(breatheAngle(i), breatheAngle(i), 0.0, 1), 1.0, 0.0, 1)
+      - 0.36787944)*108.0 / 255.0;
+}
+
+// CIE lightness of a luminance in [0, 1], scaled to 0-255
+static constexpr uint8_t perceived(double luminance)
+{
+  return (luminance <= 0.008856 ? 903.3*luminance :
+      116.0*newtonCbrt(luminance, 1.0, 20) - 16.0) * 2.55 + 0.5;
+}
+
+static constexpr uint8_t breatheLevel(int i)
+{
+  return perceived(breatheLight(i));
+}
+
+#define BREATHE_KEY(i) { (i) * (BREATHE_PERIOD / BREATHE_KEYS), breatheLevel(i) }
+#define BREATHE_KEY_4(i) BREATHE_KEY(i), BREATHE_KEY(i + 1), BREATHE_KEY(i + 2), BREATHE_KEY(i + 3)
+#define BREATHE_KEY_20(i) BREATHE_KEY_4(i), BREATHE_KEY_4(i + 4), BREATHE_KEY_4(i + 8), \
+  BREATHE_KEY_4(i + 12), BREATHE_KEY_4(i + 16)
+
+static constexpr LEDKeyframe breatheKeys[BREATHE_KEYS] PROGMEM = {
+  BREATHE_KEY_20(0), BREATHE_KEY_20(20)
+};
+
+// All four LEDs breathe together
+constexpr LEDPattern BREATHE_PATTERN PROGMEM = {
+  BREATHE_PERIOD,
+  {
+    TRACK(breatheKeys, 0),
+    TRACK(breatheKeys, 0),
+    TRACK(breatheKeys, 0),
+    TRACK(breatheKeys, 0)
+  }
+};
+
+static_assert(patternValid(BREATHE_PATTERN), "bad BREATHE_PATTERN");
+
+// The breath rolls from the right-hand LED to the left, an eighth apart
+constexpr LEDPattern ROLLING_BREATHE_PATTERN PROGMEM = {
+  BREATHE_PERIOD,
+  {
+    TRACK(breatheKeys, 3 * BREATHE_PERIOD/8),
+    TRACK(breatheKeys, 2 * BREATHE_PERIOD/8),
+    TRACK(breatheKeys, BREATHE_PERIOD/8),
+    TRACK(breatheKeys, 0)
+  }
+};
+
+static_assert(patternValid(ROLLING_BREATHE_PATTERN), "bad ROLLING_BREATHE_PATTERN");
+
+// A double thump over a dim glow, spreading out from the middle LEDs
+static constexpr LEDKeyframe heartbeatKeys[] PROGMEM = {
+  { 0, 8 }, { 60, 200 }, { 180, 24 }, { 260, 150 }, { 420, 8 }
+};
+
+constexpr LEDPattern HEARTBEAT_PATTERN PROGMEM = {
+  1200,
+  {
+    TRACK(heartbeatKeys, 1200 - 60),
+    TRACK(heartbeatKeys, 0),
+    TRACK(heartbeatKeys, 0),
+    TRACK(heartbeatKeys, 1200 - 60)
+  }
+};
+
+static_assert(patternValid(HEARTBEAT_PATTERN), "bad HEARTBEAT_PATTERN");
+
+PatternPlayer::PatternPlayer()
+{
+  pattern = NULL;
+}
+
+/**
+ * Starts a pattern from its beginning.
+ */
+void PatternPlayer::start(const LEDPattern *value)
+{
+  pattern = value;
+  period = pgm_read_word(&pattern->period);
+  time = 0;
+
+  for (uint8_t i = 0; i < NUM_LED_TRACKS; i++)
+    load(i, 0);
+
+  advance(0);
+}
+
+/**
+ * Moves the pattern on by elapsed ms and works out each LED's level.
+ */
+void PatternPlayer::advance(unsigned long elapsed)
+{
+  if (pattern == NULL)
+    return;
+
+  // Only divide when the pattern loops
+  if (elapsed < (unsigned long) (period - time))
+    time += elapsed;
+  else
+    time = (time + elapsed) % period;
+
+  for (uint8_t i = 0; i < NUM_LED_TRACKS; i++)
+  {
+    uint16_t offset = pgm_read_word(&pattern->tracks[i].offset);
+    uint16_t t = time < period - offset ? time + offset : time - (period - offset);
+
+    seek(i, t);
+
+    Ramp &ramp = ramps[i];
+    uint8_t fraction = ((uint32_t) (t - ramp.start) * ramp.scale) >> 8;
+    levels[i] = ramp.from + (((int32_t) ramp.delta * fraction) >> 8);
+  }
+}
+
+uint8_t PatternPlayer::getLevel(uint8_t track)
+{
+  return levels[track];
+}
+
+/**
+ * Makes sure a track's ramp covers t, which only ever moves forward or
+ * wraps back round to the start of the pattern.
+ */
+void PatternPlayer::seek(uint8_t track, uint16_t t)
+{
+  Ramp &ramp = ramps[track];
+
+  if (t < ramp.start)
+    load(track, 0);
+
+  while (t >= ramp.end)
+    load(track, ramp.key + 1);
+}
+
+/**
+ * Reads the ramp starting at a keyframe from flash. The last keyframe ramps
+ * to the first at the end of the period.
+ */
+void PatternPlayer::load(uint8_t track, uint8_t key)
+{
+  Ramp &ramp = ramps[track];
+  const LEDKeyframe *keys = (const LEDKeyframe*) pgm_read_ptr(&pattern->tracks[track].keys);
+  uint8_t count = pgm_read_byte(&pattern->tracks[track].count);
+  uint8_t next = key + 1 < count ? key + 1 : 0;
+
+  ramp.key = key;
+  ramp.start = pgm_read_word(&keys[key].time);
+  ramp.end = next ? pgm_read_word(&keys[next].time) : period;
+  ramp.from = pgm_read_byte(&keys[key].level);
+  ramp.delta = pgm_read_byte(&keys[next].level) - ramp.from;
+
+  // Turns ms into the ramp into a 0-255 fraction with one multiply
+  uint16_t length = ramp.end - ramp.start;
+  ramp.scale = length > 1 ? 65536UL / length : 0;
+}
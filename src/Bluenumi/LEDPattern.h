@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef LEDPATTERN_H_
+#define LEDPATTERN_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#define NUM_LED_TRACKS 4 // One per LED, in SECONDS0_PIN to SECONDS3_PIN order
+
+/**
+ * A point on an LED's brightness curve, time ms into the pattern. Levels are
+ * perceived brightness, 0-255; LEDController gamma-corrects them.
+ */
+struct LEDKeyframe
+{
+  uint16_t time;
+  uint8_t level;
+};
+
+/**
+ * The curve one LED follows: keyframes in time order, the first at 0, with
+ * the level ramping linearly from each to the next and from the last back
+ * round to the first. offset runs the track that many ms ahead, so tracks
+ * can share keyframes.
+ */
+struct LEDTrack
+{
+  const LEDKeyframe *keys;
+  uint8_t count;
+  uint16_t offset;
+};
+
+/**
+ * A looping LED pattern, all in flash. New patterns are just data; see
+ * LEDPattern.cpp.
+ */
+struct LEDPattern
+{
+  uint16_t period; // ms
+  LEDTrack tracks[NUM_LED_TRACKS];
+};
+
+/**
+ * Plays an LEDPattern. Each track remembers which ramp it is on and that
+ * ramp's endpoints and slope, so a frame costs a couple of multiplies per
+ * LED however many keyframes the pattern has; flash is only read again
+ * when a track moves on to its next ramp.
+ */
+class PatternPlayer
+{
+  public:
+    PatternPlayer();
+    void start(const LEDPattern*);
+    void advance(unsigned long);
+    uint8_t getLevel(uint8_t);
+
+  private:
+    struct Ramp
+    {
+      uint8_t key; // Index of the keyframe the ramp starts at
+      uint16_t start; // ms into the pattern
+      uint16_t end;
+      uint8_t from;
+      int16_t delta; // Level change over the ramp
+      uint16_t scale; // 65536 / ramp length
+    };
+
+    const LEDPattern *pattern;
+    uint16_t period;
+    uint16_t time; // ms into the pattern
+    Ramp ramps[NUM_LED_TRACKS];
+    uint8_t levels[NUM_LED_TRACKS];
+    void seek(uint8_t, uint16_t);
+    void load(uint8_t, uint8_t);
+};
+
+// Built-in patterns
+extern const LEDPattern BREATHE_PATTERN PROGMEM;
+extern const LEDPattern ROLLING_BREATHE_PATTERN PROGMEM;
+extern const LEDPattern HEARTBEAT_PATTERN PROGMEM;
+
+#endif // LEDPATTERN_H_
@@ -17,11 +17,91 @@
 
 #include "Melody.h"
 
-uint16_t TONE_UP_NOTES[] = {NOTE_A4, NOTE_CS5, NOTE_E5};
-uint16_t TONE_UP_DURATIONS[] = {DUR_QT, DUR_QT, DUR_QT};
-Melody TONE_UP_MELODY = Melody(TONE_UP_NOTES, TONE_UP_DURATIONS, 3);
+/**
+ * Packed melody format
+ *
+ * A melody is a string of bytes read in either direction. A byte with the
+ * top bit clear plays a note for the current duration: it holds an index
+ * into noteFrequencies, where 0 is a rest. A byte with the top bit set
+ * (MELODY_DURATION) changes the current duration, to its low three bits
+ * when playing forward and to bits 5-3 when playing backward. A melody
+ * starts and ends with a duration byte, so both directions know the
+ * duration of the first note they meet. Most notes take one byte; a note
+ * with a new duration takes two.
+ */
+
+static constexpr uint16_t noteFrequencies[NUM_NOTE_CODES] PROGMEM = {
+  NOTE_RST,
+  NOTE_B0,
+  NOTE_C1, NOTE_CS1, NOTE_D1, NOTE_DS1, NOTE_E1, NOTE_F1,
+  NOTE_FS1, NOTE_G1, NOTE_GS1, NOTE_A1, NOTE_AS1, NOTE_B1,
+  NOTE_C2, NOTE_CS2, NOTE_D2, NOTE_DS2, NOTE_E2, NOTE_F2,
+  NOTE_FS2, NOTE_G2, NOTE_GS2, NOTE_A2, NOTE_AS2, NOTE_B2,
+  NOTE_C3, NOTE_CS3, NOTE_D3, NOTE_DS3, NOTE_E3, NOTE_F3,
+  NOTE_FS3, NOTE_G3, NOTE_GS3, NOTE_A3, NOTE_AS3, NOTE_B3,
+  NOTE_C4, NOTE_CS4, NOTE_D4, NOTE_DS4, NOTE_E4, NOTE_F4,
+  NOTE_FS4, NOTE_G4, NOTE_GS4, NOTE_A4, NOTE_AS4, NOTE_B4,
+  NOTE_C5, NOTE_CS5, NOTE_D5, NOTE_DS5, NOTE_E5, NOTE_F5,
+  NOTE_FS5, NOTE_G5, NOTE_GS5, NOTE_A5, NOTE_AS5, NOTE_B5,
+  NOTE_C6, NOTE_CS6, NOTE_D6, NOTE_DS6, NOTE_E6, NOTE_F6,
+  NOTE_FS6, NOTE_G6, NOTE_GS6, NOTE_A6, NOTE_AS6, NOTE_B6,
+  NOTE_C7, NOTE_CS7, NOTE_D7, NOTE_DS7, NOTE_E7, NOTE_F7,
+  NOTE_FS7, NOTE_G7, NOTE_GS7, NOTE_A7, NOTE_AS7, NOTE_B7,
+  NOTE_C8, NOTE_CS8, NOTE_D8, NOTE_DS8,
+  NOTE_BEEP
+};
+
+static constexpr uint16_t durations[NUM_DURATION_CODES] PROGMEM = {
+  DUR_WH, DUR_H, DUR_DQ, DUR_Q, DUR_QT, DUR_DE, DUR_E, DUR_ET
+};
+
+static_assert(noteFrequencies[NOTE_CODE_BEEP] == NOTE_BEEP, "note codes are out of step");
+
+// Not constexpr, so using a frequency missing from the table fails to compile
+uint8_t unknownNote();
+
+static constexpr uint8_t noteCode(uint16_t frequency, uint8_t code = 0)
+{
+  return code == NUM_NOTE_CODES ? unknownNote() :
+      noteFrequencies[code] == frequency ? code : noteCode(frequency, code + 1);
+}
+
+// Shorthands for the melodies below
+#define N(note) noteCode(note)
+#define D(from, to) MELODY_DURATION(DUR_CODE_##from, DUR_CODE_##to)
+
+uint16_t noteFrequency(uint8_t code)
+{
+  return code < NUM_NOTE_CODES ? pgm_read_word(&noteFrequencies[code]) : NOTE_RST;
+}
+
+uint16_t durationMillis(uint8_t code)
+{
+  return pgm_read_word(&durations[code & 0x07]);
+}
+
+static constexpr uint8_t TONE_UP_DATA[] PROGMEM = {
+  D(QT, QT), N(NOTE_A4), N(NOTE_CS5), N(NOTE_E5), D(QT, QT)
+};
+const Melody TONE_UP_MELODY PROGMEM = {TONE_UP_DATA, sizeof(TONE_UP_DATA)};
+
+static constexpr uint8_t TONE_UP2_DATA[] PROGMEM = {
+  D(QT, QT), N(NOTE_A5), N(NOTE_CS6), N(NOTE_E6), D(QT, QT)
+};
+const Melody TONE_UP2_MELODY PROGMEM = {TONE_UP2_DATA, sizeof(TONE_UP2_DATA)};
+
+static constexpr uint8_t SINGLE_BEEP_DATA[] PROGMEM = {
+  D(ET, ET), N(NOTE_BEEP), D(ET, ET)
+};
+const Melody SINGLE_BEEP_MELODY PROGMEM = {SINGLE_BEEP_DATA, sizeof(SINGLE_BEEP_DATA)};
 
-uint16_t TONE_UP2_NOTES[] = {NOTE_A5, NOTE_CS6, NOTE_E6};
-uint16_t TONE_UP2_DURATIONS[] = {DUR_QT, DUR_QT, DUR_QT};
-Melody TONE_UP2_MELODY = Melody(TONE_UP2_NOTES, TONE_UP2_DURATIONS, 3);
+static constexpr uint8_t DOUBLE_BEEP_DATA[] PROGMEM = {
+  D(ET, ET), N(NOTE_BEEP), N(NOTE_RST), N(NOTE_BEEP), D(ET, ET)
+};
+const Melody DOUBLE_BEEP_MELODY PROGMEM = {DOUBLE_BEEP_DATA, sizeof(DOUBLE_BEEP_DATA)};
 
+// One beep followed by a rest, repeated for as long as the alarm sounds
+static constexpr uint8_t ALARM_DATA[] PROGMEM = {
+  D(ET, ET), N(NOTE_BEEP), D(ET, E), N(NOTE_RST), D(E, E)
+};
+const Melody ALARM_MELODY PROGMEM = {ALARM_DATA, sizeof(ALARM_DATA)};
@@ -19,6 +19,7 @@
 #define MELODY_H_
 
 #include <inttypes.h>
+#include <avr/pgmspace.h>
 
 #define NOTE_RST 0
 #define NOTE_B0  31
@@ -123,21 +124,44 @@
 #define DUR_E      128
 #define DUR_ET      85
 
+// Duration codes of the packed format, one per DUR_* value
+#define DUR_CODE_WH 0
+#define DUR_CODE_H  1
+#define DUR_CODE_DQ 2
+#define DUR_CODE_Q  3
+#define DUR_CODE_QT 4
+#define DUR_CODE_DE 5
+#define DUR_CODE_E  6
+#define DUR_CODE_ET 7
+#define NUM_DURATION_CODES 8
+
+// Note codes: 0 is a rest, then every NOTE_* from B0 to DS8 in order
+#define NOTE_CODE_RST 0
+#define NOTE_CODE_BEEP 90
+#define NUM_NOTE_CODES 91
+
+// A byte with the top bit set changes the duration instead of playing a
+// note: bits 5-3 hold the duration code before it, bits 2-0 the one after
+#define MELODY_DURATION_FLAG 0x80
+#define MELODY_DURATION(from, to) (MELODY_DURATION_FLAG | ((from) << 3) | (to))
+
+/**
+ * A packed melody in flash: data holds size bytes of note codes and
+ * duration changes (see Melody.cpp). Melody objects live in flash too.
+ */
 struct Melody
 {
-  uint16_t *notes;
-  uint16_t *durations;
-  uint16_t length;
-
-  Melody(uint16_t *notes, uint16_t *durations, uint16_t length)
-  {
-    this->notes = notes;
-    this->durations = durations;
-    this->length = length;
-  }
+  const uint8_t *data;
+  uint16_t size;
 };
 
-extern Melody TONE_UP_MELODY;
-extern Melody TONE_UP2_MELODY;
+uint16_t noteFrequency(uint8_t);
+uint16_t durationMillis(uint8_t);
+
+extern const Melody TONE_UP_MELODY;
+extern const Melody TONE_UP2_MELODY;
+extern const Melody SINGLE_BEEP_MELODY;
+extern const Melody DOUBLE_BEEP_MELODY;
+extern const Melody ALARM_MELODY;
 
 #endif // MELODY_H_
@@ -0,0 +1,337 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+extern "C" {
+  #include <inttypes.h>
+  #include <string.h>
+  #include <util/crc16.h>
+}
+
+#include "MelodyUpload.h"
+#include "Melody.h"
+#include "AudioController.h"
+#include "AlarmSchedule.h"
+#include "Display.h"
+
+static_assert(SETTINGS_RAM_OFFSET + SETTINGS_SIZE <= CUSTOM_MELODY_RAM_OFFSET,
+    "settings run into the custom melody");
+
+MelodyUploader::MelodyUploader()
+{
+  size = 0;
+  uploading = false;
+  received = 0;
+  lastActivity = 0;
+}
+
+/**
+ * Loads a record, normally the one read back from DS1307 RAM. Returns false
+ * and forgets the custom melody if the record is missing or corrupt.
+ */
+bool MelodyUploader::load(const uint8_t *record)
+{
+  if (!check(record))
+  {
+    size = 0;
+    return false;
+  }
+
+  size = record[1];
+  memcpy(melody, record + CUSTOM_MELODY_HEADER, size);
+
+  return true;
+}
+
+/**
+ * Reads the record's header from the DS1307, then only as much melody as it
+ * claims to hold, and loads it.
+ */
+bool MelodyUploader::loadFromRam()
+{
+  const uint8_t *record = DS1307RTC.ramBuffer + CUSTOM_MELODY_RAM_OFFSET;
+
+  size = 0;
+
+  if (!DS1307RTC.getRamRange(CUSTOM_MELODY_RAM_OFFSET, CUSTOM_MELODY_HEADER) ||
+      record[0] != CUSTOM_MELODY_MAGIC || record[1] < 2 || record[1] > CUSTOM_MELODY_MAX_SIZE)
+    return false;
+
+  if (!DS1307RTC.getRamRange(CUSTOM_MELODY_RAM_OFFSET + CUSTOM_MELODY_HEADER, record[1]))
+    return false;
+
+  return load(record);
+}
+
+bool MelodyUploader::isValid()
+{
+  return size > 0;
+}
+
+const uint8_t *MelodyUploader::getData()
+{
+  return melody;
+}
+
+uint8_t MelodyUploader::getSize()
+{
+  return size;
+}
+
+/**
+ * Opens the serial port and waits for records until one is stored or
+ * MELODY_UPLOAD_TIMEOUT passes without a byte.
+ */
+void MelodyUploader::beginUpload()
+{
+  Serial.begin(MELODY_UPLOAD_BAUD);
+  uploading = true;
+  received = 0;
+  lastActivity = millis();
+}
+
+bool MelodyUploader::isUploading()
+{
+  return uploading;
+}
+
+/**
+ * Takes in whatever the serial port has received. Call often enough that
+ * its buffer can't overflow, every 50 ms or less at MELODY_UPLOAD_BAUD.
+ * Bytes are left in the buffer while the DS1307 is busy, so a record never
+ * goes into ramBuffer while an earlier transfer may still be using it.
+ */
+void MelodyUploader::update()
+{
+  if (!uploading)
+    return;
+
+  unsigned long now = millis();
+
+  while (Serial.available() > 0 && !DS1307RTC.isBusy())
+  {
+    receive(Serial.read());
+    lastActivity = now;
+  }
+
+  // Drop a record the sender gave up on part way through
+  if (received > 0 && now - lastActivity > MELODY_UPLOAD_BYTE_TIMEOUT)
+  {
+    received = 0;
+    Serial.print("ERR\r\n");
+  }
+
+  if (received == 0 && !DS1307RTC.isBusy() && now - lastActivity > MELODY_UPLOAD_TIMEOUT)
+  {
+    uploading = false;
+    Serial.end();
+  }
+}
+
+/**
+ * Checks the header, the CRC, and that the melody is one the player can
+ * stream: a duration byte at both ends and only known notes in between.
+ */
+bool MelodyUploader::check(const uint8_t *record)
+{
+  uint8_t length = record[1];
+  const uint8_t *data = record + CUSTOM_MELODY_HEADER;
+
+  if (record[0] != CUSTOM_MELODY_MAGIC || length < 2 || length > CUSTOM_MELODY_MAX_SIZE)
+    return false;
+
+  uint8_t crc = _crc_ibutton_update(0, length);
+
+  for (uint8_t i = 0; i < length; i++)
+    crc = _crc_ibutton_update(crc, data[i]);
+
+  if (crc != record[2])
+    return false;
+
+  if (!(data[0] & MELODY_DURATION_FLAG) || !(data[length - 1] & MELODY_DURATION_FLAG))
+    return false;
+
+  for (uint8_t i = 0; i < length; i++)
+  {
+    if (!(data[i] & MELODY_DURATION_FLAG) && data[i] >= NUM_NOTE_CODES)
+      return false;
+  }
+
+  return true;
+}
+
+void MelodyUploader::receive(uint8_t value)
+{
+  // Resynchronise on a magic byte
+  if (received == 0 && value != CUSTOM_MELODY_MAGIC && value != ALARM_RECORD_MAGIC &&
+      value != NIGHT_RECORD_MAGIC)
+    return;
+
+  record[received++] = value;
+
+  if (record[0] == ALARM_RECORD_MAGIC)
+  {
+    if (received == ALARM_RECORD_SIZE)
+      finishAlarm();
+  }
+  else if (record[0] == NIGHT_RECORD_MAGIC)
+  {
+    if (received == NIGHT_RECORD_SIZE)
+      finishNight();
+  }
+  else if (received == 2 && (value < 2 || value > CUSTOM_MELODY_MAX_SIZE))
+  {
+    received = 0;
+    Serial.print("ERR\r\n");
+  }
+  else if (received > 2 && received == CUSTOM_MELODY_HEADER + record[1])
+  {
+    finish();
+  }
+}
+
+/**
+ * Stores a complete record in DS1307 RAM as one write. The sender hears
+ * back once the write is done.
+ */
+void MelodyUploader::finish()
+{
+  received = 0;
+
+  if (!check(record))
+  {
+    Serial.print("ERR\r\n");
+    Audio.doubleBeep();
+    return;
+  }
+
+  uint8_t length = CUSTOM_MELODY_HEADER + record[1];
+
+  memcpy(DS1307RTC.ramBuffer + CUSTOM_MELODY_RAM_OFFSET, record, length);
+
+  if (!DS1307RTC.sendRamRange(CUSTOM_MELODY_RAM_OFFSET, length, &stored))
+  {
+    Serial.print("ERR\r\n");
+    Audio.doubleBeep();
+  }
+}
+
+/**
+ * Sets an alarm slot from a complete alarm record and starts saving it
+ * straight away, leaving the port open for more.
+ */
+void MelodyUploader::finishAlarm()
+{
+  Alarm alarm = {record[2], record[3], record[4], record[5]};
+  uint8_t crc = 0;
+
+  received = 0;
+
+  for (uint8_t i = 1; i < ALARM_RECORD_SIZE - 1; i++)
+    crc = _crc_ibutton_update(crc, record[i]);
+
+  if (crc != record[ALARM_RECORD_SIZE - 1] || record[1] >= MAX_ALARMS ||
+      !AlarmSchedule::isValid(&alarm))
+  {
+    Serial.print("ERR\r\n");
+    Audio.doubleBeep();
+    return;
+  }
+
+  Alarms.set(record[1], &alarm);
+  saveSettings();
+}
+
+/**
+ * Sets the night brightness profile from a complete night record and
+ * starts saving it straight away, leaving the port open for more.
+ */
+void MelodyUploader::finishNight()
+{
+  uint8_t crc = 0;
+
+  received = 0;
+
+  for (uint8_t i = 1; i < NIGHT_RECORD_SIZE - 1; i++)
+    crc = _crc_ibutton_update(crc, record[i]);
+
+  if (crc != record[NIGHT_RECORD_SIZE - 1] || record[1] > 23 || record[2] > 23 ||
+      record[3] > DISPLAY_BRIGHTNESS_LEVELS)
+  {
+    Serial.print("ERR\r\n");
+    Audio.doubleBeep();
+    return;
+  }
+
+  Settings.set(SETTING_NIGHT_START_HOUR, record[1]);
+  Settings.set(SETTING_NIGHT_END_HOUR, record[2]);
+  Settings.set(SETTING_NIGHT_BRIGHTNESS, record[3]);
+  saveSettings();
+}
+
+/**
+ * Starts writing back the settings a record changed. A record that changed
+ * nothing is answered straight away, as it is already stored.
+ */
+void MelodyUploader::saveSettings()
+{
+  if (!Settings.isDirty())
+  {
+    Serial.print("OK\r\n");
+    Audio.singleBeep();
+  }
+  else if (!Settings.save(&saved))
+  {
+    Serial.print("ERR\r\n");
+    Audio.doubleBeep();
+  }
+}
+
+/**
+ * Answers an alarm or night record once the settings are stored. The port
+ * stays open.
+ */
+void MelodyUploader::saved(I2CRequest *request)
+{
+  if (request->status != I2C_STATUS_OK)
+  {
+    Serial.print("ERR\r\n");
+    Audio.doubleBeep();
+    return;
+  }
+
+  Serial.print("OK\r\n");
+  Audio.singleBeep();
+}
+
+void MelodyUploader::stored(I2CRequest *request)
+{
+  if (request->status != I2C_STATUS_OK)
+  {
+    Serial.print("ERR\r\n");
+    Audio.doubleBeep();
+    return;
+  }
+
+  Uploader.load(DS1307RTC.ramBuffer + CUSTOM_MELODY_RAM_OFFSET);
+  Serial.print("OK\r\n");
+  Audio.singleBeep();
+
+  Uploader.uploading = false;
+  Serial.end();
+}
+
+MelodyUploader Uploader = MelodyUploader();
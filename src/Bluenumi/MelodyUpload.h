@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef MELODYUPLOAD_H_
+#define MELODYUPLOAD_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "DS1307RTC.h"
+
+#define MELODY_UPLOAD_BAUD 9600
+#define MELODY_UPLOAD_TIMEOUT 60000 // ms of silence that ends upload mode
+#define MELODY_UPLOAD_BYTE_TIMEOUT 500 // ms gap that abandons a record
+
+// The custom melody record sits in DS1307 RAM after the settings
+#define CUSTOM_MELODY_RAM_OFFSET 24
+#define CUSTOM_MELODY_MAGIC 0xB5
+#define CUSTOM_MELODY_HEADER 3 // Magic, size, CRC-8 of size and data
+#define CUSTOM_MELODY_MAX_SIZE (RAM_SIZE - CUSTOM_MELODY_RAM_OFFSET - CUSTOM_MELODY_HEADER)
+
+// Magic, slot, hour, minute, days, flags, CRC-8 of slot to flags
+#define ALARM_RECORD_MAGIC 0xA7
+#define ALARM_RECORD_SIZE 7
+
+// Magic, night start hour, end hour, brightness, CRC-8 of the three
+#define NIGHT_RECORD_MAGIC 0xD3
+#define NIGHT_RECORD_SIZE 5
+
+/**
+ * Receives a custom alarm melody over the serial port and keeps it in
+ * DS1307 RAM. A record is the magic byte, the size of the packed melody
+ * (see Melody.cpp), a Dallas CRC-8 over the size and the melody, then the
+ * melody itself; the same bytes go over the wire and into RAM. Alarm
+ * records (see AlarmSchedule.h) set the alarm slots the buttons can't reach,
+ * and night records the hours and brightness the display dims to at night.
+ * Both go into the settings (see Settings.h).
+ *
+ * The serial pins double as the indicator LEDs, so the port is only opened
+ * by beginUpload() and closed again once a melody has been stored or
+ * nothing has arrived for MELODY_UPLOAD_TIMEOUT. Every record received is
+ * answered with "OK" once it is in RAM, or "ERR". A good melody record
+ * replaces the custom melody with a single bulk write.
+ */
+class MelodyUploader
+{
+  public:
+    MelodyUploader();
+    bool load(const uint8_t*);
+    bool loadFromRam();
+    bool isValid();
+    const uint8_t *getData();
+    uint8_t getSize();
+    void beginUpload();
+    bool isUploading();
+    void update();
+
+  private:
+    uint8_t melody[CUSTOM_MELODY_MAX_SIZE];
+    uint8_t size; // 0 if there is no valid custom melody
+    bool uploading;
+    uint8_t record[CUSTOM_MELODY_HEADER + CUSTOM_MELODY_MAX_SIZE];
+    uint8_t received;
+    unsigned long lastActivity;
+    static bool check(const uint8_t*);
+    void receive(uint8_t);
+    void finish();
+    void finishAlarm();
+    void finishNight();
+    void saveSettings();
+    static void stored(I2CRequest*);
+    static void saved(I2CRequest*);
+};
+
+extern MelodyUploader Uploader;
+
+#endif // MELODYUPLOAD_H_
@@ -0,0 +1,147 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "PortDebouncer.h"
+
+PortDebouncer::PortDebouncer()
+{
+  mask = 0;
+}
+
+/**
+ * Starts debouncing the PIND bits in the mask, taking their current levels
+ * as already settled.
+ */
+void PortDebouncer::begin(uint8_t mask)
+{
+  unsigned long now = millis();
+
+  this->mask = mask;
+  state = PIND & mask;
+  count0 = 0;
+  count1 = 0;
+  changed = 0;
+  repeats = 0;
+  armed = 0;
+
+  for (uint8_t i = 0; i < 8; i++)
+    changeTime[i] = now;
+}
+
+void PortDebouncer::update()
+{
+  uint8_t delta = (PIND & mask) ^ state;
+
+  // Count disagreeing samples; any agreeing sample resets the count
+  count1 = (count1 ^ count0) & delta;
+  count0 = ~count0 & delta;
+
+  changed = delta & ~(count0 | count1);
+  state ^= changed;
+  repeats = 0;
+
+  if (!(changed | armed))
+    return;
+
+  unsigned long now = millis();
+
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    uint8_t bit = _BV(i);
+
+    if (changed & bit)
+    {
+      // Like Bounce, a real change cancels a pending rebounce
+      changeTime[i] = now;
+      armed &= ~bit;
+    }
+    else if ((armed & bit) && now - changeTime[i] >= rebounceInterval[i])
+    {
+      changeTime[i] = now;
+      armed &= ~bit;
+      repeats |= bit;
+    }
+  }
+}
+
+/**
+ * Debounced levels of the inputs.
+ */
+uint8_t PortDebouncer::read()
+{
+  return state;
+}
+
+/**
+ * Inputs that went high on the last update.
+ */
+uint8_t PortDebouncer::risingEdge()
+{
+  return changed & state;
+}
+
+/**
+ * Inputs that went low on the last update.
+ */
+uint8_t PortDebouncer::fallingEdge()
+{
+  return changed & ~state;
+}
+
+/**
+ * Inputs whose rebounce came due on the last update.
+ */
+uint8_t PortDebouncer::repeated()
+{
+  return repeats;
+}
+
+/**
+ * Returns whether every input reads as its debounced state, with no change
+ * being counted.
+ */
+bool PortDebouncer::isSettled()
+{
+  return !(count0 | count1) && (PIND & mask) == state;
+}
+
+/**
+ * Milliseconds the input on PIND bit i has been in its current state, or
+ * since it last repeated.
+ */
+unsigned long PortDebouncer::duration(uint8_t i)
+{
+  return millis() - changeTime[i];
+}
+
+/**
+ * Like Bounce::rebounce: the inputs in the mask report a repeat once they
+ * have held their state for interval ms more. Each repeat has to be asked
+ * for again, which makes auto-repeat easy to stop.
+ */
+void PortDebouncer::rebounce(uint8_t mask, uint16_t interval)
+{
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    if (mask & _BV(i))
+      rebounceInterval[i] = interval;
+  }
+
+  armed |= mask & this->mask;
+}
+
+PortDebouncer Buttons = PortDebouncer();
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef PORTDEBOUNCER_H_
+#define PORTDEBOUNCER_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+/**
+ * Debounces up to eight PORTD inputs from one read of PIND per update(),
+ * using a two bit vertical counter per input: a bit's debounced state only
+ * changes after four updates in a row disagree with it. Results are bitmasks
+ * in PIND bit order, so two inputs changing on the same update are seen
+ * together.
+ */
+class PortDebouncer
+{
+  public:
+    PortDebouncer();
+    void begin(uint8_t);
+    void update();
+    uint8_t read();
+    uint8_t risingEdge();
+    uint8_t fallingEdge();
+    uint8_t repeated();
+    bool isSettled();
+    unsigned long duration(uint8_t);
+    void rebounce(uint8_t, uint16_t);
+
+  private:
+    uint8_t mask;
+    uint8_t state;
+    uint8_t count0; // Low bits of the per-input counters
+    uint8_t count1; // High bits
+    uint8_t changed;
+    uint8_t repeats;
+    uint8_t armed; // Inputs with a rebounce pending
+    unsigned long changeTime[8];
+    uint16_t rebounceInterval[8];
+};
+
+extern PortDebouncer Buttons;
+
+#endif // PORTDEBOUNCER_H_
@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "Scheduler.h"
+
+Scheduler::Scheduler()
+{
+  numTasks = 0;
+}
+
+/**
+ * Adds a task and returns its id, or NO_TASK if the table is full. Periodic
+ * tasks start right away; one-shot tasks (period 0) wait for schedule().
+ */
+uint8_t Scheduler::add(TaskHandler handler, unsigned long period, unsigned long deadline)
+{
+  if (numTasks >= MAX_TASKS)
+    return NO_TASK;
+
+  Task *task = &tasks[numTasks];
+
+  task->handler = handler;
+  task->period = period;
+  task->deadline = deadline;
+  task->nextRun = millis();
+  task->active = period > 0;
+
+  return numTasks++;
+}
+
+/**
+ * Runs a task once, delay ms from now. Rescheduling a pending task moves it.
+ */
+void Scheduler::schedule(uint8_t id, unsigned long delay)
+{
+  if (id >= numTasks)
+    return;
+
+  tasks[id].nextRun = millis() + delay;
+  tasks[id].active = true;
+}
+
+void Scheduler::cancel(uint8_t id)
+{
+  if (id < numTasks)
+    tasks[id].active = false;
+}
+
+bool Scheduler::isScheduled(uint8_t id)
+{
+  return id < numTasks && tasks[id].active;
+}
+
+/**
+ * Returns whether any task is due now.
+ */
+bool Scheduler::isDue()
+{
+  unsigned long now = millis();
+
+  for (uint8_t i = 0; i < numTasks; i++)
+  {
+    if (tasks[i].active && (long) (now - tasks[i].nextRun) >= 0)
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * Returns whether a one-shot task is waiting to run.
+ */
+bool Scheduler::hasPending()
+{
+  for (uint8_t i = 0; i < numTasks; i++)
+  {
+    if (tasks[i].active && tasks[i].period == 0)
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * Makes every periodic task due now, for when millis() stood still while
+ * time went by, as in power-down sleep.
+ */
+void Scheduler::catchUp()
+{
+  unsigned long now = millis();
+
+  for (uint8_t i = 0; i < numTasks; i++)
+  {
+    if (tasks[i].active && tasks[i].period > 0)
+      tasks[i].nextRun = now;
+  }
+}
+
+void Scheduler::run()
+{
+  for (uint8_t i = 0; i < numTasks; i++)
+  {
+    Task *task = &tasks[i];
+    unsigned long now = millis();
+
+    if (!task->active || (long) (now - task->nextRun) < 0)
+      continue;
+
+    due = task->nextRun;
+    unsigned long lateness = now - due;
+
+    if (task->period > 0)
+    {
+      // Keep the phase unless a whole period was missed
+      task->nextRun += task->period;
+
+      if ((long) (now - task->nextRun) >= 0)
+        task->nextRun = now + task->period;
+    }
+    else
+    {
+      task->active = false;
+    }
+
+    unsigned long start = micros();
+    task->handler();
+    unsigned long duration = micros() - start;
+
+    task->runs++;
+    task->maxLateness = max(task->maxLateness, lateness);
+    task->maxDuration = max(task->maxDuration, duration);
+
+    if (millis() - due > task->deadline)
+      task->overruns++;
+  }
+}
+
+const Task *Scheduler::getTask(uint8_t id)
+{
+  return id < numTasks ? &tasks[id] : NULL;
+}
+
+/**
+ * Returns the time the running task became due, so a periodic task can
+ * tell how late it is and how many periods it lost to a stall.
+ */
+unsigned long Scheduler::getDue()
+{
+  return due;
+}
+
+void Scheduler::resetStats()
+{
+  for (uint8_t i = 0; i < numTasks; i++)
+  {
+    tasks[i].runs = 0;
+    tasks[i].overruns = 0;
+    tasks[i].maxLateness = 0;
+    tasks[i].maxDuration = 0;
+  }
+}
+
+Scheduler Tasks = Scheduler();
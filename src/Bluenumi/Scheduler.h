@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define MAX_TASKS 8
+#define NO_TASK 0xFF
+
+typedef void (*TaskHandler)();
+
+/**
+ * A task runs every period ms, or once per schedule() call when its period
+ * is 0. Its deadline is how long after becoming due it may take to finish;
+ * finishing later counts as an overrun.
+ */
+struct Task
+{
+  TaskHandler handler;
+  unsigned long period;
+  unsigned long deadline;
+  unsigned long nextRun;
+  bool active;
+
+  // Statistics
+  unsigned long runs;
+  uint16_t overruns;
+  unsigned long maxLateness; // Longest wait from due to start, in ms
+  unsigned long maxDuration; // Longest run, in us
+};
+
+/**
+ * Cooperative scheduler with a fixed task table. Tasks are added once at
+ * startup and run to completion from loop(), in the order they were added,
+ * whenever they are due. One-shot tasks stand in for delay(): instead of
+ * blocking, the code that would have waited schedules a continuation.
+ */
+class Scheduler
+{
+  public:
+    Scheduler();
+    uint8_t add(TaskHandler, unsigned long, unsigned long);
+    void schedule(uint8_t, unsigned long);
+    void cancel(uint8_t);
+    bool isScheduled(uint8_t);
+    bool isDue();
+    bool hasPending();
+    void catchUp();
+    void run();
+    const Task *getTask(uint8_t);
+    unsigned long getDue();
+    void resetStats();
+
+  private:
+    Task tasks[MAX_TASKS];
+    uint8_t numTasks;
+    unsigned long due; // When the running task became due
+};
+
+extern Scheduler Tasks;
+
+#endif // SCHEDULER_H_
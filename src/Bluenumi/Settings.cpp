@@ -0,0 +1,236 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+extern "C" {
+  #include <inttypes.h>
+  #include <util/crc16.h>
+}
+
+#include <avr/pgmspace.h>
+#include "Settings.h"
+#include "Display.h"
+#include "AlarmSchedule.h"
+
+#define ALL_SETTINGS ((1UL << NUM_SETTINGS) - 1)
+
+// Largest valid value of each alarm field, then of the settings after the
+// alarms, in Setting order
+static const uint8_t alarmLimits[SETTINGS_PER_ALARM] PROGMEM = {
+  23, // SETTING_ALARM_HOUR
+  59, // SETTING_ALARM_MINUTE
+  ALARM_EVERY_DAY, // SETTING_ALARM_DAYS
+  ALARM_ENABLED | ALARM_ONE_SHOT // SETTING_ALARM_FLAGS
+};
+
+static const uint8_t settingLimits[NUM_SETTINGS - SETTING_NIGHT_START_HOUR] PROGMEM = {
+  23, // SETTING_NIGHT_START_HOUR
+  23, // SETTING_NIGHT_END_HOUR
+  DISPLAY_BRIGHTNESS_LEVELS // SETTING_NIGHT_BRIGHTNESS
+};
+
+static_assert(NUM_SETTINGS <= 32, "dirty bits don't cover every setting");
+static_assert(SETTINGS_RAM_OFFSET + SETTINGS_SIZE <= RAM_SIZE, "settings don't fit in RAM");
+
+SettingsStore::SettingsStore()
+{
+  for (uint8_t i = 0; i < NUM_SETTINGS; i++)
+    values[i] = 0;
+
+  // Nothing is known to be stored until load() succeeds
+  dirty = ALL_SETTINGS;
+  lastChange = 0;
+  changes = 0;
+  writes = 0;
+  saved = NULL;
+}
+
+/**
+ * Reads the settings from the DS1307. Returns false, leaving the values
+ * alone and all of them due to be written back, if the stored block isn't
+ * valid.
+ */
+bool SettingsStore::load()
+{
+  const uint8_t *block = DS1307RTC.ramBuffer + SETTINGS_RAM_OFFSET;
+
+  if (!DS1307RTC.getRamRange(SETTINGS_RAM_OFFSET, SETTINGS_SIZE) ||
+      block[0] != SETTINGS_VERSION)
+    return false;
+
+  uint8_t crc = 0;
+
+  for (uint8_t i = 0; i < NUM_SETTINGS; i++)
+  {
+    uint8_t value = block[SETTINGS_HEADER + i];
+
+    if (value > limit(i))
+      return false;
+
+    crc = _crc_ibutton_update(crc, value);
+  }
+
+  if (crc != block[1])
+    return false;
+
+  for (uint8_t i = 0; i < NUM_SETTINGS; i++)
+    values[i] = block[SETTINGS_HEADER + i];
+
+  dirty = 0;
+
+  return true;
+}
+
+uint8_t SettingsStore::get(Setting setting)
+{
+  return values[setting];
+}
+
+void SettingsStore::set(Setting setting, uint8_t value)
+{
+  if (values[setting] == value)
+    return;
+
+  values[setting] = value;
+  dirty |= 1UL << setting;
+  lastChange = millis();
+  changes++;
+}
+
+bool SettingsStore::isDirty()
+{
+  return dirty != 0;
+}
+
+/**
+ * Writes back dirty settings once they have been left alone for
+ * SETTINGS_WRITE_DELAY and the DS1307 is free. Call regularly.
+ */
+void SettingsStore::update()
+{
+  if (dirty && millis() - lastChange >= SETTINGS_WRITE_DELAY && !DS1307RTC.isBusy())
+    write();
+}
+
+/**
+ * Writes back dirty settings now, waiting for the DS1307 if need be.
+ */
+void SettingsStore::flush()
+{
+  if (!dirty)
+    return;
+
+  DS1307RTC.wait();
+  write();
+}
+
+/**
+ * Starts writing back dirty settings now and has done called with the
+ * request once the write ends. Returns false, and done is never called, if
+ * the DS1307 is busy, nothing is dirty or the write can't be queued.
+ */
+bool SettingsStore::save(I2CCallback done)
+{
+  if (!dirty || DS1307RTC.isBusy())
+    return false;
+
+  saved = done;
+
+  if (write())
+    return true;
+
+  saved = NULL;
+
+  return false;
+}
+
+uint16_t SettingsStore::getChanges()
+{
+  return changes;
+}
+
+uint16_t SettingsStore::getWrites()
+{
+  return writes;
+}
+
+/**
+ * Copies the header and the fields up to the last dirty one into ramBuffer
+ * and starts writing them. Fields changed after this are marked dirty
+ * again and go out with the next write.
+ */
+bool SettingsStore::write()
+{
+  uint8_t *block = DS1307RTC.ramBuffer + SETTINGS_RAM_OFFSET;
+  uint8_t last = NUM_SETTINGS - 1;
+
+  while (!(dirty & (1UL << last)))
+    last--;
+
+  block[0] = SETTINGS_VERSION;
+  block[1] = checksum();
+
+  for (uint8_t i = 0; i <= last; i++)
+    block[SETTINGS_HEADER + i] = values[i];
+
+  if (!DS1307RTC.sendRamRange(SETTINGS_RAM_OFFSET, SETTINGS_HEADER + last + 1, &written))
+    return false;
+
+  dirty = 0;
+  writes++;
+
+  return true;
+}
+
+/**
+ * Tries the whole block again later if the write didn't make it, and tells
+ * whoever called save().
+ */
+void SettingsStore::written(I2CRequest *request)
+{
+  I2CCallback done = Settings.saved;
+
+  Settings.saved = NULL;
+
+  if (request->status != I2C_STATUS_OK)
+  {
+    Settings.dirty = ALL_SETTINGS;
+    Settings.lastChange = millis();
+  }
+
+  if (done)
+    done(request);
+}
+
+uint8_t SettingsStore::limit(uint8_t setting)
+{
+  if (setting < SETTING_NIGHT_START_HOUR)
+    return pgm_read_byte(&alarmLimits[setting % SETTINGS_PER_ALARM]);
+
+  return pgm_read_byte(&settingLimits[setting - SETTING_NIGHT_START_HOUR]);
+}
+
+uint8_t SettingsStore::checksum()
+{
+  uint8_t crc = 0;
+
+  for (uint8_t i = 0; i < NUM_SETTINGS; i++)
+    crc = _crc_ibutton_update(crc, values[i]);
+
+  return crc;
+}
+
+SettingsStore Settings = SettingsStore();
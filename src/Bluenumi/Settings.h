@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef SETTINGS_H_
+#define SETTINGS_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "DS1307RTC.h"
+
+#define SETTINGS_RAM_OFFSET 0
+#define SETTINGS_VERSION 2 // Bump when the fields change meaning or order
+#define SETTINGS_HEADER 2 // Version, CRC-8 of the fields
+#define SETTINGS_WRITE_DELAY 2000 // ms without a change before writing back
+#define SETTINGS_ALARMS 4 // Alarm slots stored
+#define SETTINGS_PER_ALARM 4 // Hour, minute, days, flags
+
+/**
+ * Settings kept in DS1307 RAM, in layout order. Each has a largest valid
+ * value (see Settings.cpp); hours are on the 24 hour clock. The alarm
+ * fields are those of the first slot, and slot n's follow at
+ * n * SETTINGS_PER_ALARM (see alarmSetting()).
+ */
+enum Setting
+{
+  SETTING_ALARM_HOUR,
+  SETTING_ALARM_MINUTE,
+  SETTING_ALARM_DAYS,
+  SETTING_ALARM_FLAGS,
+  SETTING_NIGHT_START_HOUR = SETTINGS_ALARMS * SETTINGS_PER_ALARM,
+  SETTING_NIGHT_END_HOUR,
+  SETTING_NIGHT_BRIGHTNESS,
+  NUM_SETTINGS
+};
+
+#define SETTINGS_SIZE (SETTINGS_HEADER + NUM_SETTINGS)
+
+inline Setting alarmSetting(uint8_t alarm, Setting field)
+{
+  return (Setting) (alarm * SETTINGS_PER_ALARM + field);
+}
+
+/**
+ * The settings that survive a power cut, kept in RAM and written back to
+ * the DS1307 in the background. set() only marks a field dirty; once no
+ * field has changed for SETTINGS_WRITE_DELAY, update() writes the header
+ * and the fields up to the last dirty one as a single transaction, so a
+ * burst of button presses costs one write.
+ *
+ * save() writes them back straight away without waiting, for callers that
+ * must know when they are stored.
+ *
+ * load() reads just the settings block and rejects it unless the version,
+ * the CRC and every field check out, as after a battery swap.
+ */
+class SettingsStore
+{
+  public:
+    SettingsStore();
+    bool load();
+    uint8_t get(Setting);
+    void set(Setting, uint8_t);
+    bool isDirty();
+    void update();
+    void flush();
+    bool save(I2CCallback);
+
+    // Statistics
+    uint16_t getChanges();
+    uint16_t getWrites();
+
+  private:
+    uint8_t values[NUM_SETTINGS];
+    uint32_t dirty; // One bit per Setting
+    unsigned long lastChange;
+    uint16_t changes;
+    uint16_t writes;
+    I2CCallback saved; // Told when the write started by save() ends
+    bool write();
+    static uint8_t limit(uint8_t);
+    uint8_t checksum();
+    static void written(I2CRequest*);
+};
+
+extern SettingsStore Settings;
+
+#endif // SETTINGS_H_
@@ -0,0 +1,278 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "SoftClock.h"
+#include "DS1307RTC.h"
+
+#define SECONDS_PER_DAY 86400L
+
+SoftClock::SoftClock()
+{
+  pendingTicks = 0;
+  resyncInterval = CLOCK_RESYNC_INTERVAL;
+}
+
+void SoftClock::begin()
+{
+  sync();
+}
+
+void SoftClock::update()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t ticks = pendingTicks;
+  pendingTicks = 0;
+  SREG = oldSREG;
+
+  while (ticks--)
+  {
+    advance();
+    secondsSinceSync++;
+  }
+
+  if (secondsSinceSync >= resyncInterval && !syncing)
+  {
+    syncAttempts = 0;
+    requestSync();
+  }
+}
+
+/**
+ * Reloads the time from the DS1307, waiting for the read to finish.
+ */
+void SoftClock::sync()
+{
+  syncAttempts = 0;
+  requestSync();
+
+  while (syncing)
+    DS1307RTC.wait();
+}
+
+void SoftClock::requestSync()
+{
+  syncTickCount = tickCount;
+  syncing = DS1307RTC.requestDateTime(&syncDone);
+}
+
+void SoftClock::syncDone(I2CRequest *request)
+{
+  Clock.finishSync(request->status == I2C_STATUS_OK);
+}
+
+/**
+ * Takes the time just read from the DS1307 and records any difference from
+ * the local copy. A read that overlaps a tick can't tell whether the tick is
+ * already included, so it is retried.
+ */
+void SoftClock::finishSync(bool ok)
+{
+  syncing = false;
+
+  if (!ok)
+  {
+    // Keep counting; the next interval tries again
+    secondsSinceSync = 0;
+    return;
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+
+  if (tickCount != syncTickCount)
+  {
+    SREG = oldSREG;
+
+    if (++syncAttempts < CLOCK_SYNC_ATTEMPTS)
+      requestSync();
+    else
+      secondsSinceSync = 0;
+
+    return;
+  }
+
+  // Ticks still pending came before the read, so it already includes them.
+  // Any tick from here on stays pending and lands on top of it.
+  uint8_t ticks = pendingTicks;
+  pendingTicks = 0;
+  SREG = oldSREG;
+
+  while (ticks--)
+    advance();
+
+  long before = secondOfDay();
+  bool firstSync = resyncs == 0;
+
+  DS1307RTC.readDateTime(&second, &minute, &hour, &dayOfWeek, &dayOfMonth, 
+      &month, &year, &twelveHourMode, &ampm);
+
+  secondsSinceSync = 0;
+  resyncs++;
+
+  if (firstSync)
+    return;
+
+  long drift = before - secondOfDay();
+
+  // Report the shortest way around midnight
+  if (drift > SECONDS_PER_DAY/2)
+    drift -= SECONDS_PER_DAY;
+  else if (drift < -SECONDS_PER_DAY/2)
+    drift += SECONDS_PER_DAY;
+
+  lastDrift = drift;
+
+  if (drift != 0)
+    mismatches++;
+}
+
+/**
+ * Sets the DS1307, starting its clock and 1 Hz square wave, and the local
+ * copy together. Writing the seconds restarts the DS1307's countdown, so the
+ * next tick is a full second away.
+ */
+void SoftClock::setDateTime(
+  uint8_t second, 
+  uint8_t minute, 
+  uint8_t hour, 
+  uint8_t dayOfWeek, 
+  uint8_t dayOfMonth, 
+  uint8_t month, 
+  uint8_t year,
+  bool twelveHourMode,
+  bool ampm)
+{
+  DS1307RTC.setDateTime(second, minute, hour, dayOfWeek, dayOfMonth, month, 
+      year, twelveHourMode, ampm, true, DS1307::CR_1HZ_LOW);
+
+  pendingTicks = 0;
+  this->second = second;
+  this->minute = minute;
+  this->hour = hour;
+  this->dayOfWeek = dayOfWeek;
+  this->dayOfMonth = dayOfMonth;
+  this->month = month;
+  this->year = year;
+  this->twelveHourMode = twelveHourMode;
+  this->ampm = twelveHourMode ? ampm : hour >= 12;
+  secondsSinceSync = 0;
+}
+
+void SoftClock::getTime(uint8_t *hour, uint8_t *minute, bool *ampm, bool *twelveHourMode)
+{
+  update();
+
+  *hour = this->hour;
+  *minute = this->minute;
+  *ampm = this->ampm;
+  *twelveHourMode = this->twelveHourMode;
+}
+
+uint8_t SoftClock::getDayOfWeek()
+{
+  update();
+  return dayOfWeek;
+}
+
+void SoftClock::setResyncInterval(uint16_t seconds)
+{
+  resyncInterval = seconds;
+}
+
+uint16_t SoftClock::getResyncs()
+{
+  return resyncs;
+}
+
+uint16_t SoftClock::getMismatches()
+{
+  return mismatches;
+}
+
+/**
+ * Local time minus RTC time, in seconds, as found by the last resync.
+ */
+int16_t SoftClock::getLastDrift()
+{
+  return lastDrift;
+}
+
+void SoftClock::advance()
+{
+  if (++second < 60)
+    return;
+
+  second = 0;
+
+  if (++minute < 60)
+    return;
+
+  minute = 0;
+
+  bool newDay;
+
+  if (twelveHourMode)
+  {
+    if (++hour == 12)
+      ampm = !ampm;
+    else if (hour == 13)
+      hour = 1;
+
+    newDay = hour == 12 && !ampm;
+  }
+  else
+  {
+    hour = (hour + 1) % 24;
+    ampm = hour >= 12;
+    newDay = hour == 0;
+  }
+
+  if (!newDay)
+    return;
+
+  dayOfWeek = dayOfWeek % 7 + 1;
+
+  uint8_t daysInMonth;
+
+  if (month == 2)
+    daysInMonth = year % 4 == 0 ? 29 : 28;
+  else if (month == 4 || month == 6 || month == 9 || month == 11)
+    daysInMonth = 30;
+  else
+    daysInMonth = 31;
+
+  if (++dayOfMonth <= daysInMonth)
+    return;
+
+  dayOfMonth = 1;
+
+  if (++month <= 12)
+    return;
+
+  month = 1;
+  year = (year + 1) % 100;
+}
+
+long SoftClock::secondOfDay()
+{
+  uint8_t hours24 = twelveHourMode ? hour % 12 + (ampm ? 12 : 0) : hour;
+
+  return hours24 * 3600L + minute * 60L + second;
+}
+
+SoftClock Clock = SoftClock();
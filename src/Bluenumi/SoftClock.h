@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef SOFTCLOCK_H_
+#define SOFTCLOCK_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "I2CBus.h"
+
+#define CLOCK_RESYNC_INTERVAL 3600 // Seconds between resyncs from the DS1307
+#define CLOCK_SYNC_ATTEMPTS 3 // Reads to try when a tick races a resync
+
+/**
+ * Local copy of the DS1307's time and date. The 1 Hz square wave interrupt
+ * calls tick(), and update() folds the counted ticks into the time using
+ * the same 12/24 hour and calendar rules as the DS1307. The RTC is only read
+ * at startup and every resync interval, which also measures how far the
+ * local copy has drifted from it. Resyncs read the RTC in the background.
+ */
+class SoftClock
+{
+  public:
+    SoftClock();
+    void begin();
+    inline void tick();
+    void update();
+    void sync();
+    void setDateTime(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, 
+        uint8_t, bool, bool);
+    void getTime(uint8_t*, uint8_t*, bool*, bool*);
+    uint8_t getDayOfWeek();
+    void setResyncInterval(uint16_t);
+    uint16_t getResyncs();
+    uint16_t getMismatches();
+    int16_t getLastDrift();
+
+  private:
+    volatile uint8_t pendingTicks;
+    volatile uint8_t tickCount;
+    uint8_t syncTickCount;
+    uint8_t syncAttempts;
+    bool syncing;
+    uint8_t second;
+    uint8_t minute;
+    uint8_t hour;
+    uint8_t dayOfWeek;
+    uint8_t dayOfMonth;
+    uint8_t month;
+    uint8_t year;
+    bool twelveHourMode;
+    bool ampm;
+    uint16_t resyncInterval;
+    uint16_t secondsSinceSync;
+    uint16_t resyncs;
+    uint16_t mismatches;
+    int16_t lastDrift;
+    void requestSync();
+    void finishSync(bool);
+    static void syncDone(I2CRequest*);
+    void advance();
+    long secondOfDay();
+};
+
+extern SoftClock Clock;
+
+/**
+ * Called from the interrupt on each falling edge of the 1 Hz square wave.
+ * Counting the tick there, at the edge, is what lets a resync tell whether
+ * its read overlapped one.
+ */
+inline void SoftClock::tick()
+{
+  pendingTicks++;
+  tickCount++;
+}
+
+#endif // SOFTCLOCK_H_
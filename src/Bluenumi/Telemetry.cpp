@@ -0,0 +1,164 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+extern "C" {
+  #include <inttypes.h>
+  #include <string.h>
+  #include <util/crc16.h>
+}
+
+#include "Telemetry.h"
+#include "I2CBus.h"
+#include "Scheduler.h"
+
+#ifdef __AVR__
+// The end of .bss and the top of the heap, set by the linker and malloc()
+extern char __heap_start;
+extern char *__brkval;
+#endif
+
+// Not cleared at startup, so a reset leaves the last session for send()
+uint16_t RuntimeTelemetry::magic __attribute__((section(".noinit")));
+TelemetryData RuntimeTelemetry::data __attribute__((section(".noinit")));
+
+RuntimeTelemetry::RuntimeTelemetry()
+{
+  lowWater = NULL;
+}
+
+/**
+ * Writes the record kept from before the last reset, if RAM holds one, as
+ * a frame on the serial port, then closes the port again.
+ */
+void RuntimeTelemetry::send()
+{
+  if (magic != TELEMETRY_MAGIC)
+    return;
+
+  const uint8_t *bytes = (const uint8_t*) &data;
+  uint8_t header[TELEMETRY_FRAME_HEADER];
+  uint8_t crc = _crc_ibutton_update(0, sizeof(data));
+
+  for (uint8_t i = 0; i < sizeof(data); i++)
+    crc = _crc_ibutton_update(crc, bytes[i]);
+
+  header[0] = TELEMETRY_FRAME_MAGIC;
+  header[1] = sizeof(data);
+  header[2] = crc;
+
+  Serial.begin(TELEMETRY_BAUD);
+  Serial.write(header, TELEMETRY_FRAME_HEADER);
+  Serial.write(bytes, sizeof(data));
+  Serial.end();
+}
+
+/**
+ * Starts a new record and paints the free RAM below the stack. Call early
+ * in setup(), while the stack is still shallow.
+ */
+void RuntimeTelemetry::begin()
+{
+  memset(&data, 0, sizeof(data));
+  magic = TELEMETRY_MAGIC;
+
+#ifdef __AVR__
+  uint8_t *top = (uint8_t*) SP;
+
+  for (uint8_t *p = (uint8_t*) heapEnd(); p < top; p++)
+    *p = TELEMETRY_PAINT;
+
+  lowWater = top;
+#endif
+}
+
+/**
+ * Counts one loop() iteration that spent elapsed us running tasks.
+ */
+void RuntimeTelemetry::recordLoop(unsigned long elapsed)
+{
+  unsigned long steps = elapsed >> 2; // micros() counts in 4 us steps
+  uint8_t bucket = 0;
+
+  while (steps && bucket < TELEMETRY_LOOP_BUCKETS - 1)
+  {
+    steps >>= 1;
+    bucket++;
+  }
+
+  if (data.loopHistogram[bucket] != 0xFFFFFFFFUL)
+    data.loopHistogram[bucket]++;
+
+  if (elapsed > data.maxLoop)
+    data.maxLoop = elapsed;
+}
+
+void RuntimeTelemetry::recordModeHandler(uint8_t mode, unsigned long elapsed)
+{
+  uint16_t value = min(elapsed, 0xFFFFUL);
+
+  if (value > data.maxModeHandler[mode])
+    data.maxModeHandler[mode] = value;
+}
+
+/**
+ * Brings the counters kept elsewhere into the record, and lowers the stack
+ * high-water mark to the deepest byte overwritten since the last call.
+ */
+void RuntimeTelemetry::update()
+{
+  uint16_t overruns = 0;
+
+  for (uint8_t i = 0; Tasks.getTask(i); i++)
+    overruns += Tasks.getTask(i)->overruns;
+
+  data.i2cTransactions = I2C.getTransactions();
+  data.i2cErrors = I2C.getErrors();
+  data.i2cTimeouts = I2C.getTimeouts();
+  data.taskOverruns = overruns;
+
+#ifdef __AVR__
+  const uint8_t *bottom = heapEnd();
+  const uint8_t *p = bottom;
+
+  while (p < lowWater && *p == TELEMETRY_PAINT)
+    p++;
+
+  lowWater = p;
+  data.minFreeRam = p - bottom;
+  data.stackHighWater = RAMEND + 1 - (uint16_t) p;
+#endif
+}
+
+const TelemetryData *RuntimeTelemetry::getData()
+{
+  return &data;
+}
+
+/**
+ * The first byte of RAM nothing has claimed. The host build has no AVR
+ * memory map, so it measures no stack.
+ */
+const uint8_t *RuntimeTelemetry::heapEnd()
+{
+#ifdef __AVR__
+  return (const uint8_t*) (__brkval ? __brkval : &__heap_start);
+#else
+  return NULL;
+#endif
+}
+
+RuntimeTelemetry Telemetry = RuntimeTelemetry();
@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "Bluenumi.h"
+
+#define TELEMETRY_MAGIC 0x7E1E
+#define TELEMETRY_BAUD 9600
+#define TELEMETRY_LOOP_BUCKETS 16 // Bucket i > 0 counts 2^(i+1) to 2^(i+2)-1 us
+#define TELEMETRY_PAINT 0xC5 // Fills the free RAM the stack hasn't reached
+
+// A frame is the magic, the size of the data, a Dallas CRC-8 over the size
+// and the data, then the data itself, like a melody record
+#define TELEMETRY_FRAME_MAGIC 0xC3
+#define TELEMETRY_FRAME_HEADER 3
+
+/**
+ * What the firmware has seen since power-up. Sent as it is laid out in RAM,
+ * little-endian with no padding, so a change here is a change of the frame.
+ */
+struct TelemetryData
+{
+  uint32_t loopHistogram[TELEMETRY_LOOP_BUCKETS];
+  uint32_t maxLoop; // us
+  uint32_t i2cTransactions;
+  uint16_t maxModeHandler[NUM_RUN_MODES]; // us, by RunMode
+  uint16_t i2cErrors; // NACKs and bus errors
+  uint16_t i2cTimeouts;
+  uint16_t taskOverruns; // Across all tasks
+  uint16_t stackHighWater; // Bytes of stack ever in use, ISRs included
+  uint16_t minFreeRam; // Bytes between the heap and the deepest stack
+};
+
+static_assert(sizeof(TelemetryData) == 92, "telemetry frame layout changed");
+
+/**
+ * Keeps a compact record of how the firmware runs, for finding stalls on a
+ * clock in the field: a histogram of the time each loop() spends running
+ * tasks, the longest each run mode handler took, I2C traffic and failures,
+ * deadline overruns, and how close the stack has come to the heap.
+ *
+ * The stack figures come from painting the free RAM at begin() and finding
+ * the lowest byte since overwritten, which update() does from the bottom
+ * up; it costs about 5 cycles for every byte still free.
+ *
+ * The serial pins double as the indicator LEDs, so nothing is printed while
+ * the clock runs. The record sits in RAM that the C runtime leaves alone,
+ * and send() writes the one from before a reset as a single binary frame at
+ * the next power-up, before begin() starts over. A USB serial adapter that
+ * resets the board on connecting is enough to collect it.
+ */
+class RuntimeTelemetry
+{
+  public:
+    RuntimeTelemetry();
+    void send();
+    void begin();
+    void recordLoop(unsigned long);
+    void recordModeHandler(uint8_t, unsigned long);
+    void update();
+    const TelemetryData *getData();
+
+  private:
+    static uint16_t magic;
+    static TelemetryData data;
+    const uint8_t *lowWater; // Lowest byte of RAM known to be in use
+    static const uint8_t *heapEnd();
+};
+
+extern RuntimeTelemetry Telemetry;
+
+#endif // TELEMETRY_H_
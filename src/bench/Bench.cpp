@@ -0,0 +1,198 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Benchmark firmware: runs the hot paths of the Bluenumi firmware, each
+ * BENCH_REPEAT times between GPIOR markers, for BenchRunner to count the
+ * cycles of in a simulated ATmega328P. It links with the sketch, whose
+ * setup() and loop() are renamed out of the way, so the code measured is
+ * the code that ships.
+ */
+
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include "Benchmarks.h"
+#include "Display.h"
+#include "LEDController.h"
+#include "DS1307RTC.h"
+#include "PortDebouncer.h"
+#include "AlarmSchedule.h"
+#include "EventQueue.h"
+
+#define BENCH_REPEAT 64 // Calls measured per benchmark
+
+#define HZ_BIT _BV(4) // PIND bit of the RTC square wave
+#define BUTTON_BITS (_BV(3) | _BV(2))
+
+// Defined in the sketch
+void checkAlarm(uint16_t);
+extern "C" void PCINT2_vect(void);
+
+typedef void (*BenchCall)(uint8_t);
+
+static unsigned long ledDue;
+
+/**
+ * Calls call(i) between the markers for benchmark id, with interrupts off
+ * so that none lands in the measurement.
+ */
+static void measure(uint8_t id, BenchCall call, uint8_t i)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+
+  GPIOR0 = id;
+  call(i);
+  GPIOR1 = 0;
+
+  SREG = oldSREG;
+}
+
+static void benchEmpty(uint8_t i)
+{
+}
+
+static void benchOutputTime(uint8_t i)
+{
+  // A new minute every call, so every frame goes out
+  Display.outputTime(12, i % 60);
+}
+
+static void benchLEDs(uint8_t i)
+{
+  ledDue += LED_FRAME_PERIOD;
+  LEDs.update(ledDue);
+}
+
+static void benchRTCRequest(uint8_t i)
+{
+  DS1307RTC.requestDateTime(NULL);
+}
+
+static void benchRTCRead(uint8_t i)
+{
+  uint8_t second, minute, hour, dayOfWeek, dayOfMonth, month, year;
+  bool twelveHourMode, ampm;
+
+  DS1307RTC.readDateTime(&second, &minute, &hour, &dayOfWeek, &dayOfMonth,
+      &month, &year, &twelveHourMode, &ampm);
+}
+
+static void benchDebounce(uint8_t i)
+{
+  Buttons.update();
+}
+
+static void benchCheckAlarm(uint8_t i)
+{
+  // The alarm set up in setup() goes off halfway through
+  checkAlarm(AlarmSchedule::minuteOfWeek(1, 6, i));
+}
+
+static void benchPCINT2(uint8_t i)
+{
+  PCINT2_vect();
+}
+
+/**
+ * Drives the square wave pin from the MCU itself, since the simulator has
+ * no DS1307. Outputs read back through PIND, unlike undriven pull-ups.
+ */
+static void setSquareWave(bool high)
+{
+  if (high)
+    PORTD |= HZ_BIT;
+  else
+    PORTD &= ~HZ_BIT;
+
+  DDRD |= HZ_BIT;
+}
+
+void setup()
+{
+  Display.begin();
+  LEDs.begin();
+  LEDs.setEnabled(true);
+  DS1307RTC.begin();
+  Buttons.begin(BUTTON_BITS);
+
+  Alarm alarm = {6, BENCH_REPEAT / 2, ALARM_EVERY_DAY, ALARM_ENABLED};
+  Alarms.set(0, &alarm);
+
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+    measure(BENCH_EMPTY, &benchEmpty, i);
+
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+    measure(BENCH_OUTPUT_TIME, &benchOutputTime, i);
+
+  LEDs.setPattern(&BREATHE_PATTERN);
+
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+    measure(BENCH_LED_BREATHE, &benchLEDs, i);
+
+  LEDs.setPattern(&ROLLING_BREATHE_PATTERN);
+
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+    measure(BENCH_LED_ROLLING, &benchLEDs, i);
+
+  // Without a DS1307 each request fails, which only costs waiting time
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+  {
+    measure(BENCH_RTC_REQUEST, &benchRTCRequest, i);
+    DS1307RTC.wait();
+  }
+
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+    measure(BENCH_RTC_READ, &benchRTCRead, i);
+
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+    measure(BENCH_DEBOUNCE, &benchDebounce, i);
+
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+    measure(BENCH_CHECK_ALARM, &benchCheckAlarm, i);
+
+  // The handler returns with reti, which enables interrupts before the
+  // stop marker; with Timer0's interrupts masked there are none to take
+  uint8_t timsk0 = TIMSK0;
+  TIMSK0 = 0;
+
+  // Alternate the edges, emptying the queue the ticks go into
+  for (uint8_t i = 0; i < BENCH_REPEAT; i++)
+  {
+    Event event;
+
+    setSquareWave(true);
+    measure(BENCH_PCINT2_OTHER, &benchPCINT2, i);
+    setSquareWave(false);
+    measure(BENCH_PCINT2_TICK, &benchPCINT2, i);
+
+    while (Events.pop(&event))
+      ;
+  }
+
+  TIMSK0 = timsk0;
+
+  // Sleeping with interrupts off ends the simulation
+  cli();
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+  sleep_cpu();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,321 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Runs the benchmark firmware in simavr and reports the cycles each
+ * benchmark took per call, net of the markers' own cost (the empty
+ * benchmark). Writes the results as JSON and exits with status 1 if any
+ * benchmark's worst call is over its budget, or has no budget.
+ *
+ * Budgets are only ever measured: --record runs the benchmarks and writes
+ * each one's worst call plus BENCH_MARGIN_PERCENT to a budgets file, which
+ * --budgets checks later runs against. A benchmark the file doesn't list
+ * fails, so a new one can't pass unmeasured.
+ *
+ * Usage: bench-runner [--json FILE] (--budgets FILE | --record FILE) <bench.elf>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_io.h>
+
+#include "Benchmarks.h"
+
+#define BENCH_MCU "atmega328p"
+#define BENCH_F_CPU 16000000
+#define BENCH_MARGIN_PERCENT 25 // Headroom a recorded budget leaves
+#define NO_BUDGET 0 // Not in the budgets file
+
+struct Benchmark
+{
+  const char *key; // Name in the budgets file
+  const char *name;
+};
+
+static const Benchmark benchmarks[] = {
+  {"empty", "empty"},
+  {"output_time", "SegmentDisplay::outputTime"},
+  {"led_breathe", "LEDController::update (breathe)"},
+  {"led_rolling", "LEDController::update (rolling breathe)"},
+  {"rtc_request", "DS1307::requestDateTime"},
+  {"rtc_read", "DS1307::readDateTime"},
+  {"debounce", "PortDebouncer::update"},
+  {"check_alarm", "checkAlarm"},
+  {"pcint2_tick", "PCINT2_vect (tick)"},
+  {"pcint2_other", "PCINT2_vect (other edge)"},
+};
+
+static_assert(sizeof(benchmarks) / sizeof(benchmarks[0]) == NUM_BENCHMARKS,
+    "a benchmark has no name");
+
+static uint32_t budgets[NUM_BENCHMARKS]; // Cycles the worst call may take
+
+struct Result
+{
+  uint32_t calls;
+  uint64_t total;
+  uint32_t min;
+  uint32_t max;
+};
+
+static Result results[NUM_BENCHMARKS];
+static uint8_t current = NUM_BENCHMARKS; // Benchmark between the markers
+static avr_cycle_count_t startCycle;
+
+static void startWritten(avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param)
+{
+  current = value;
+  startCycle = avr->cycle;
+}
+
+static void stopWritten(avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param)
+{
+  if (current >= NUM_BENCHMARKS)
+    return;
+
+  uint32_t cycles = avr->cycle - startCycle;
+  Result *result = &results[current];
+
+  if (result->calls == 0 || cycles < result->min)
+    result->min = cycles;
+
+  if (cycles > result->max)
+    result->max = cycles;
+
+  result->calls++;
+  result->total += cycles;
+  current = NUM_BENCHMARKS;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [--json FILE] (--budgets FILE | --record FILE) <bench.elf>\n", name);
+}
+
+/**
+ * Reads "key cycles" lines, skipping blank lines and # comments. Returns
+ * false if the file can't be read or names an unknown benchmark.
+ */
+static bool readBudgets(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  char line[128];
+
+  if (!file)
+  {
+    fprintf(stderr, "cannot read %s\n", path);
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), file))
+  {
+    char key[64];
+    unsigned long cycles;
+
+    if (line[0] == '#' || sscanf(line, "%63s", key) != 1)
+      continue;
+
+    uint8_t i = 0;
+
+    while (i < NUM_BENCHMARKS && strcmp(benchmarks[i].key, key) != 0)
+      i++;
+
+    if (i == NUM_BENCHMARKS || sscanf(line, "%*s %lu", &cycles) != 1)
+    {
+      fprintf(stderr, "%s: bad budget line: %s", path, line);
+      fclose(file);
+      return false;
+    }
+
+    budgets[i] = cycles;
+  }
+
+  fclose(file);
+  return true;
+}
+
+/**
+ * Writes each benchmark's worst call plus BENCH_MARGIN_PERCENT, rounded up.
+ */
+static bool writeBudgets(const char *path, const uint32_t *maxCycles)
+{
+  FILE *file = fopen(path, "w");
+
+  if (!file)
+  {
+    fprintf(stderr, "cannot write %s\n", path);
+    return false;
+  }
+
+  fprintf(file, "# Cycle budgets for make run, written by make budgets: the worst\n");
+  fprintf(file, "# call measured in simavr plus %d%%, net of the markers' cost.\n",
+      BENCH_MARGIN_PERCENT);
+
+  for (uint8_t i = 0; i < NUM_BENCHMARKS; i++)
+  {
+    if (i == BENCH_EMPTY)
+      continue;
+
+    uint32_t budget = (maxCycles[i] * (100 + BENCH_MARGIN_PERCENT) + 99) / 100;
+
+    fprintf(file, "%s %u # measured %u\n", benchmarks[i].key, budget, maxCycles[i]);
+  }
+
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  const char *jsonPath = NULL;
+  const char *budgetsPath = NULL;
+  const char *recordPath = NULL;
+  const char *elfPath = NULL;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+      jsonPath = argv[++i];
+    else if (strcmp(argv[i], "--budgets") == 0 && i + 1 < argc)
+      budgetsPath = argv[++i];
+    else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      recordPath = argv[++i];
+    else if (!elfPath && argv[i][0] != '-')
+      elfPath = argv[i];
+    else
+    {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (!elfPath || !budgetsPath == !recordPath)
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (budgetsPath && !readBudgets(budgetsPath))
+    return 2;
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+
+  if (elf_read_firmware(elfPath, &firmware) != 0)
+  {
+    fprintf(stderr, "cannot read %s\n", elfPath);
+    return 2;
+  }
+
+  avr_t *avr = avr_make_mcu_by_name(BENCH_MCU);
+
+  if (!avr)
+  {
+    fprintf(stderr, "simavr has no %s\n", BENCH_MCU);
+    return 2;
+  }
+
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+  avr->frequency = BENCH_F_CPU;
+
+  avr_register_io_write(avr, BENCH_START_ADDRESS, &startWritten, NULL);
+  avr_register_io_write(avr, BENCH_STOP_ADDRESS, &stopWritten, NULL);
+
+  int state = cpu_Running;
+
+  while (state != cpu_Done && state != cpu_Crashed)
+    state = avr_run(avr);
+
+  if (state == cpu_Crashed)
+  {
+    fprintf(stderr, "the benchmark firmware crashed\n");
+    return 2;
+  }
+
+  // The markers' own cost, taken off every other benchmark
+  uint32_t overhead = results[BENCH_EMPTY].calls ? results[BENCH_EMPTY].min : 0;
+  uint32_t maxCycles[NUM_BENCHMARKS];
+  FILE *json = jsonPath ? fopen(jsonPath, "w") : NULL;
+  bool failed = false;
+
+  if (jsonPath && !json)
+  {
+    fprintf(stderr, "cannot write %s\n", jsonPath);
+    return 2;
+  }
+
+  if (json)
+    fprintf(json, "{\n  \"mcu\": \"%s\",\n  \"f_cpu\": %u,\n  \"benchmarks\": [\n",
+        BENCH_MCU, BENCH_F_CPU);
+
+  printf("%-40s %6s %8s %8s %8s %8s\n", "benchmark", "calls", "min", "mean", "max", "budget");
+
+  for (uint8_t i = 0; i < NUM_BENCHMARKS; i++)
+  {
+    const Benchmark *benchmark = &benchmarks[i];
+    const Result *result = &results[i];
+    uint32_t net = i == BENCH_EMPTY ? 0 : overhead;
+    uint32_t min = result->calls ? result->min - net : 0;
+    uint32_t max = result->calls ? result->max - net : 0;
+    double mean = result->calls ? (double) result->total / result->calls - net : 0;
+    uint32_t budget = budgets[i];
+    const char *verdict = "";
+
+    if (result->calls == 0)
+      verdict = "  NOT RUN";
+    else if (recordPath || i == BENCH_EMPTY) // Nothing to check against
+      verdict = "";
+    else if (budget == NO_BUDGET)
+      verdict = "  NO BUDGET";
+    else if (max > budget)
+      verdict = "  OVER BUDGET";
+
+    maxCycles[i] = max;
+
+    if (verdict[0])
+      failed = true;
+
+    printf("%-40s %6u %8u %8.1f %8u %8u%s\n", benchmark->name, result->calls,
+        min, mean, max, budget, verdict);
+
+    if (json)
+      fprintf(json, "    {\"name\": \"%s\", \"calls\": %u, \"min\": %u, \"mean\": %.1f, "
+          "\"max\": %u, \"budget\": %u, \"ok\": %s}%s\n",
+          benchmark->name, result->calls, min, mean, max, budget,
+          verdict[0] ? "false" : "true", i + 1 < NUM_BENCHMARKS ? "," : "");
+  }
+
+  if (json)
+  {
+    fprintf(json, "  ],\n  \"overhead\": %u,\n  \"ok\": %s\n}\n", overhead,
+        failed ? "false" : "true");
+    fclose(json);
+  }
+
+  if (failed)
+    return 1;
+
+  if (recordPath && !writeBudgets(recordPath, maxCycles))
+    return 2;
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef BENCHMARKS_H_
+#define BENCHMARKS_H_
+
+/**
+ * The benchmarks Bench.cpp runs, in order. BenchRunner.cpp has a name for
+ * each, in the same order, and budgets.txt a measured cycle budget.
+ *
+ * The firmware marks a measured call by writing its id to GPIOR0 just
+ * before it and anything to GPIOR1 just after. The runner watches both
+ * addresses in the simulated MCU and counts the cycles in between.
+ */
+enum BenchmarkId
+{
+  BENCH_EMPTY = 0, // Nothing between the markers, their own cost
+  BENCH_OUTPUT_TIME,
+  BENCH_LED_BREATHE,
+  BENCH_LED_ROLLING,
+  BENCH_RTC_REQUEST,
+  BENCH_RTC_READ,
+  BENCH_DEBOUNCE,
+  BENCH_CHECK_ALARM,
+  BENCH_PCINT2_TICK,
+  BENCH_PCINT2_OTHER,
+  NUM_BENCHMARKS
+};
+
+// Data space addresses of GPIOR0 and GPIOR1 on the ATmega328P
+#define BENCH_START_ADDRESS 0x3E
+#define BENCH_STOP_ADDRESS 0x4A
+
+#endif // BENCHMARKS_H_
@@ -0,0 +1,250 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+#define HOST_NUM_PINS 20
+#define HOST_MAX_DEVICES 8
+#define HOST_NEVER UINT64_MAX
+
+// Timer0 runs at F_CPU/64 with an 8-bit period, as set up by the Arduino core
+#define HOST_TIMER0_PERIOD_MICROS 1024
+
+// Tube brightness is OE_PIN's duty cycle averaged over 128 Timer0 periods
+#define HOST_OE_WINDOW_MICROS (128L * HOST_TIMER0_PERIOD_MICROS)
+
+// Indicator LEDs are wired to the serial pins (see Bluenumi.ino)
+#define HOST_AMPM_PIN 1
+#define HOST_ALRM_PIN 0
+
+// The TWI shares its pins with PC4 and PC5
+#define HOST_SDA_PIN 18
+#define HOST_SCL_PIN 19
+#define HOST_TWI_BUFFER 64
+
+// Same receive buffer as the Arduino core's HardwareSerial
+#define HOST_SERIAL_BUFFER 64
+
+// Longest power-down sleep before the board wakes the MCU anyway, so a run
+// still ends if nothing is left to wake it
+#define HOST_SLEEP_LIMIT_MICROS 1000000
+
+/**
+ * Anything on the simulated board that needs to act at a point in virtual
+ * time (the RTC oscillator, scripted button presses, timers) implements this
+ * interface. The board asks every device for its next event and fires them
+ * in order as the virtual clock advances.
+ */
+class HostDevice
+{
+  public:
+    virtual ~HostDevice() {}
+    virtual uint64_t nextEventMicros() = 0;
+    virtual void fireEvent(uint64_t now) = 0;
+};
+
+/**
+ * A slave on the simulated I2C bus. receive() is called with the bytes of a
+ * master write, transmit() fills a master read. Both return false/0 to NACK.
+ */
+class HostI2CDevice
+{
+  public:
+    virtual ~HostI2CDevice() {}
+    virtual bool receive(const uint8_t*, uint8_t) = 0;
+    virtual uint8_t transmit(uint8_t*, uint8_t) = 0;
+};
+
+struct HostStats
+{
+  uint64_t loops;
+  uint64_t isrCalls;
+  uint64_t timerIsrCalls;
+  uint64_t twiIsrCalls;
+  uint64_t pinWrites;
+  uint64_t pwmWrites;
+  uint64_t shiftClocks;
+  uint64_t latches;
+  uint64_t i2cTransactions;
+  uint64_t i2cBytes;
+  uint64_t i2cErrors;
+  uint64_t tones;
+  uint64_t serialBytes;
+  uint64_t serialDropped;
+  uint64_t idleMicros; // Time in idle sleep
+  uint64_t powerDownMicros; // Time in power-down sleep
+};
+
+/**
+ * The simulated Bluenumi board: an ATmega328P's pins, pin change
+ * interrupts, Timer0 compare interrupts, Timer1 PWM and TWI, the chain of
+ * four 74HC595s behind the numitrons, the piezo and the I2C bus, all driven
+ * by a virtual microsecond clock.
+ *
+ * Virtual time only moves when the firmware calls delay() or when the runner
+ * calls advance() between loop() iterations, so a simulation runs as fast as
+ * the host allows unless a speed is set.
+ */
+class HostBoard
+{
+  public:
+    typedef void (*OutputListener)();
+
+    // Clock
+    uint64_t now() { return micros; }
+    uint64_t timerNow() { return (timerStopped ? timerStopMicros : micros) - timerStoppedMicros; }
+    void advance(uint64_t);
+    void setSpeed(double);
+
+    // Peripherals
+    void attachDevice(HostDevice*);
+    void attachI2CDevice(uint8_t, HostI2CDevice*);
+    HostI2CDevice *getI2CDevice(uint8_t);
+    void stallI2C(uint8_t);
+    void setOutputListener(OutputListener);
+
+    // Pins
+    void setPinMode(uint8_t, uint8_t);
+    void writePin(uint8_t, uint8_t);
+    uint8_t readPin(uint8_t);
+    void writePwm(uint8_t, uint8_t);
+    void driveInput(uint8_t, bool, uint8_t);
+    double getBrightness(uint8_t);
+
+    // Registers and interrupts
+    uint8_t readRegister(uint8_t);
+    void writeRegister(uint8_t, uint8_t);
+    uint16_t readRegister16(uint8_t);
+    void writeRegister16(uint8_t, uint16_t);
+    void setInterruptsEnabled(bool);
+
+    // Sleep
+    void setSleepMode(uint8_t mode) { sleepMode = mode; }
+    void setSleepEnabled(bool value) { sleepEnabled = value; }
+    void sleep();
+
+    // Piezo
+    void setTone(uint8_t, unsigned int, uint64_t);
+    unsigned int getToneFrequency() { return toneFrequency; }
+
+    // Serial port
+    void setSerialOpen(bool);
+    void receiveSerial(uint8_t);
+    int serialAvailable() { return serialCount; }
+    int readSerial();
+
+    // Numitrons
+    uint32_t getFrame() { return latchedFrame; }
+    bool getTubesLit();
+    double getTubeBrightness();
+
+    HostStats stats;
+
+  private:
+    uint64_t micros;
+    uint64_t timerStoppedMicros; // Time Timer0 spent stopped in power-down
+    bool timerStopped; // In power-down now, since timerStopMicros
+    uint64_t timerStopMicros;
+    uint64_t startWallMicros;
+    double speed;
+
+    HostDevice *devices[HOST_MAX_DEVICES];
+    uint8_t numDevices;
+    HostI2CDevice *i2cDevices[128];
+    OutputListener outputListener;
+
+    uint8_t portOut[3];
+    uint8_t portDdr[3];
+    uint8_t extDriven[3];
+    uint8_t extLevel[3];
+    uint8_t lastPind;
+    uint8_t pwm[HOST_NUM_PINS];
+    bool pwmActive[HOST_NUM_PINS];
+
+    uint8_t pcicr;
+    uint8_t pcifr;
+    uint8_t pcmsk[3];
+    uint8_t timsk0;
+    uint8_t tifr0;
+    uint8_t tccr0a;
+    uint8_t tccr1a;
+    uint8_t tccr1b;
+    uint16_t timer1[NUM_HOST_REGISTERS16]; // ICR1, OCR1A, OCR1B
+    bool interruptsEnabled;
+    bool inIsr;
+
+    uint8_t sleepMode;
+    bool sleepEnabled;
+    bool sleeping;
+    bool woken; // An interrupt ran while sleeping
+
+    uint8_t twbr;
+    uint8_t twsr;
+    uint8_t twdr;
+    uint8_t twcr;
+    uint8_t twiState;
+    uint8_t twiResult;
+    uint8_t twiData;
+    uint64_t twiMicros;
+    HostI2CDevice *twiDevice;
+    uint8_t twiBuffer[HOST_TWI_BUFFER];
+    uint8_t twiLength;
+    uint8_t twiStallClocks;
+
+    uint32_t shiftRegister;
+    uint32_t latchedFrame;
+    uint64_t oeWindowMicros;
+    uint64_t oeLastMicros;
+    uint64_t oeLowMicros;
+    uint64_t oePulsedMicros;
+    double oeDuty;
+    bool oeDutyValid;
+
+    unsigned int toneFrequency;
+    uint64_t toneOffMicros;
+
+    bool serialOpen;
+    uint8_t serialBuffer[HOST_SERIAL_BUFFER];
+    uint8_t serialHead;
+    uint8_t serialCount;
+
+    uint8_t readPort(uint8_t);
+    void writePort(uint8_t, uint8_t);
+    void outputChanged(uint8_t, uint8_t);
+    void startOePulsing();
+    void accumulateOe(bool);
+    void checkPinChange();
+    uint64_t nextTimer0Micros();
+    void writeTccr0a(uint8_t);
+    void writeTwcr(uint8_t);
+    void twiStart();
+    void twiByte();
+    void twiStop();
+    void twiComplete();
+    uint64_t twiTransferMicros(uint8_t);
+    void serviceInterrupts();
+    void pace();
+    void notify();
+};
+
+extern HostBoard Board;
+
+#endif // HOST_H_
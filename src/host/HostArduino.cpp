@@ -0,0 +1,968 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <avr/sleep.h>
+
+#include "Host.h"
+#include "Display.h"
+#include "AudioController.h"
+
+#define PORT_B 0
+#define PORT_C 1
+#define PORT_D 2
+
+/*******************************************************************************
+ *
+ * Pin Mapping
+ *
+ ******************************************************************************/
+
+static inline uint8_t pinToPort(uint8_t pin)
+{
+  if (pin < 8)
+    return PORT_D;
+
+  return pin < 14 ? PORT_B : PORT_C;
+}
+
+static inline uint8_t pinToBit(uint8_t pin)
+{
+  if (pin < 8)
+    return _BV(pin);
+
+  return pin < 14 ? _BV(pin - 8) : _BV(pin - 14);
+}
+
+static inline uint8_t portBitToPin(uint8_t port, uint8_t bit)
+{
+  if (port == PORT_D)
+    return bit;
+
+  return port == PORT_B ? bit + 8 : bit + 14;
+}
+
+static uint64_t wallMicros()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*******************************************************************************
+ *
+ * HostBoard
+ *
+ ******************************************************************************/
+
+void HostBoard::advance(uint64_t duration)
+{
+  uint64_t target = micros + duration;
+
+  for (;;)
+  {
+    HostDevice *next = NULL;
+    uint64_t timer0Micros = nextTimer0Micros();
+    uint64_t nextMicros = toneOffMicros ? toneOffMicros : HOST_NEVER;
+
+    nextMicros = min(nextMicros, timer0Micros);
+
+    if (twiMicros)
+      nextMicros = min(nextMicros, twiMicros);
+
+    for (uint8_t i = 0; i < numDevices; i++)
+    {
+      uint64_t t = devices[i]->nextEventMicros();
+
+      if (t < nextMicros)
+      {
+        nextMicros = t;
+        next = devices[i];
+      }
+    }
+
+    if (nextMicros > target)
+      break;
+
+    micros = nextMicros;
+
+    if (next)
+    {
+      next->fireEvent(micros);
+    }
+    else if (micros == timer0Micros)
+    {
+      tifr0 |= timsk0 & (_BV(OCF0A) | _BV(OCF0B));
+      serviceInterrupts();
+    }
+    else if (twiMicros && micros == twiMicros)
+    {
+      twiComplete();
+    }
+    else
+    {
+      setTone(PIEZO_PIN, 0, 0);
+    }
+
+    if (woken)
+    {
+      target = micros;
+      break;
+    }
+  }
+
+  micros = target;
+  pace();
+}
+
+/**
+ * Stands in for the SLEEP instruction. Idle sleep lasts until the next
+ * interrupt, at the latest the Timer0 overflow that drives millis(), which
+ * is not otherwise modelled. Power-down stops Timer0, so millis() and
+ * micros() stand still and only a pin change wakes the MCU.
+ */
+void HostBoard::sleep()
+{
+  if (!sleepEnabled)
+    return;
+
+  uint64_t start = micros;
+  bool powerDown = sleepMode == SLEEP_MODE_PWR_DOWN;
+
+  sleeping = true;
+  woken = false;
+
+  // Interrupts that wake the MCU run before this returns, and must see
+  // millis() and micros() as they were when Timer0 stopped
+  timerStopped = powerDown;
+  timerStopMicros = start;
+
+  if (powerDown)
+    advance(HOST_SLEEP_LIMIT_MICROS);
+  else
+    advance((micros / HOST_TIMER0_PERIOD_MICROS + 1) * HOST_TIMER0_PERIOD_MICROS - micros);
+
+  sleeping = false;
+  woken = false;
+
+  if (powerDown)
+  {
+    timerStoppedMicros += micros - start;
+    timerStopped = false;
+    stats.powerDownMicros += micros - start;
+  }
+  else
+  {
+    stats.idleMicros += micros - start;
+  }
+}
+
+void HostBoard::setSpeed(double value)
+{
+  speed = value;
+  startWallMicros = wallMicros() - (speed > 0 ? (uint64_t) (micros / speed) : 0);
+}
+
+void HostBoard::attachDevice(HostDevice *device)
+{
+  if (numDevices < HOST_MAX_DEVICES)
+    devices[numDevices++] = device;
+}
+
+void HostBoard::attachI2CDevice(uint8_t address, HostI2CDevice *device)
+{
+  i2cDevices[address & 0x7f] = device;
+}
+
+HostI2CDevice *HostBoard::getI2CDevice(uint8_t address)
+{
+  return i2cDevices[address & 0x7f];
+}
+
+void HostBoard::setOutputListener(OutputListener listener)
+{
+  outputListener = listener;
+}
+
+void HostBoard::setPinMode(uint8_t pin, uint8_t mode)
+{
+  uint8_t port = pinToPort(pin);
+  uint8_t bit = pinToBit(pin);
+
+  if (mode == OUTPUT)
+  {
+    portDdr[port] |= bit;
+  }
+  else
+  {
+    portDdr[port] &= ~bit;
+
+    if (mode == INPUT_PULLUP)
+      portOut[port] |= bit;
+  }
+
+  checkPinChange();
+}
+
+void HostBoard::writePin(uint8_t pin, uint8_t val)
+{
+  uint8_t port = pinToPort(pin);
+  uint8_t bit = pinToBit(pin);
+
+  stats.pinWrites++;
+  pwmActive[pin] = false;
+
+  // Like the Arduino core, disconnect the timers from their pins
+  if (pin == 5)
+    tccr0a &= ~_BV(COM0B1);
+  else if (pin == 6)
+    tccr0a &= ~_BV(COM0A1);
+  else if (pin == 9)
+    tccr1a &= ~_BV(COM1A1);
+  else if (pin == 10)
+    tccr1a &= ~_BV(COM1B1);
+  writePort(port, val ? (portOut[port] | bit) : (portOut[port] & ~bit));
+}
+
+uint8_t HostBoard::readPin(uint8_t pin)
+{
+  return (readPort(pinToPort(pin)) & pinToBit(pin)) ? HIGH : LOW;
+}
+
+void HostBoard::writePwm(uint8_t pin, uint8_t val)
+{
+  setPinMode(pin, OUTPUT);
+
+  if (val == 0 || val == 255)
+  {
+    writePin(pin, val ? HIGH : LOW);
+    return;
+  }
+
+  stats.pwmWrites++;
+  pwmActive[pin] = true;
+  pwm[pin] = val;
+
+  // Timer0 outputs, connected the way the Arduino core's analogWrite does
+  if (pin == 5)
+    tccr0a |= _BV(COM0B1);
+  else if (pin == 6)
+    tccr0a |= _BV(COM0A1);
+}
+
+/**
+ * Clearing a COM bit hands the pin back to its PORT bit.
+ */
+void HostBoard::writeTccr0a(uint8_t val)
+{
+  if (!(val & _BV(COM0B1)))
+    pwmActive[5] = false;
+
+  if (!(val & _BV(COM0A1)))
+    pwmActive[6] = false;
+
+  tccr0a = val;
+}
+
+/**
+ * Drives an input pin from outside the MCU. Buttons and the DS1307 square
+ * wave are open drain, so they either pull the pin low or release it
+ * (driven = false) and let the internal pull-up take over.
+ */
+void HostBoard::driveInput(uint8_t pin, bool driven, uint8_t level)
+{
+  uint8_t port = pinToPort(pin);
+  uint8_t bit = pinToBit(pin);
+
+  if (driven)
+    extDriven[port] |= bit;
+  else
+    extDriven[port] &= ~bit;
+
+  if (level)
+    extLevel[port] |= bit;
+  else
+    extLevel[port] &= ~bit;
+
+  checkPinChange();
+}
+
+/**
+ * Returns the share of the time (0-1) an LED on the given pin is lit. Timer1
+ * is modelled in fast PWM with TOP in ICR1, the only mode the firmware uses,
+ * where a compare value of v gives v + 1 counts out of TOP + 1.
+ */
+double HostBoard::getBrightness(uint8_t pin)
+{
+  uint16_t top = timer1[REG_ICR1];
+
+  if (pin == 9 && (tccr1a & _BV(COM1A1)))
+    return min(timer1[REG_OCR1A] + 1.0, top + 1.0) / (top + 1.0);
+
+  if (pin == 10 && (tccr1a & _BV(COM1B1)))
+    return min(timer1[REG_OCR1B] + 1.0, top + 1.0) / (top + 1.0);
+
+  if (pwmActive[pin])
+    return pwm[pin] / 255.0;
+
+  return readPin(pin) ? 1.0 : 0.0;
+}
+
+uint8_t HostBoard::readRegister(uint8_t id)
+{
+  switch (id)
+  {
+    case REG_PINB: return readPort(PORT_B);
+    case REG_PINC: return readPort(PORT_C);
+    case REG_PIND: return readPort(PORT_D);
+    case REG_DDRB: return portDdr[PORT_B];
+    case REG_DDRC: return portDdr[PORT_C];
+    case REG_DDRD: return portDdr[PORT_D];
+    case REG_PORTB: return portOut[PORT_B];
+    case REG_PORTC: return portOut[PORT_C];
+    case REG_PORTD: return portOut[PORT_D];
+    case REG_PCICR: return pcicr;
+    case REG_PCIFR: return pcifr;
+    case REG_PCMSK0: return pcmsk[0];
+    case REG_PCMSK1: return pcmsk[1];
+    case REG_PCMSK2: return pcmsk[2];
+    case REG_SREG: return interruptsEnabled ? _BV(SREG_I) : 0;
+    case REG_TIMSK0: return timsk0;
+    case REG_TIFR0: return tifr0;
+    case REG_TCCR0A: return tccr0a;
+    case REG_TCCR1A: return tccr1a;
+    case REG_TCCR1B: return tccr1b;
+    case REG_TWBR: return twbr;
+    case REG_TWSR: return twsr;
+    case REG_TWDR: return twdr;
+    case REG_TWCR: return twcr;
+    default: return 0;
+  }
+}
+
+void HostBoard::writeRegister(uint8_t id, uint8_t val)
+{
+  switch (id)
+  {
+    // Writing a one to a PINx bit toggles the PORTx bit
+    case REG_PINB: writePort(PORT_B, portOut[PORT_B] ^ val); break;
+    case REG_PINC: writePort(PORT_C, portOut[PORT_C] ^ val); break;
+    case REG_PIND: writePort(PORT_D, portOut[PORT_D] ^ val); break;
+    case REG_DDRB: portDdr[PORT_B] = val; break;
+    case REG_DDRC: portDdr[PORT_C] = val; break;
+    case REG_DDRD: portDdr[PORT_D] = val; checkPinChange(); break;
+    case REG_PORTB: writePort(PORT_B, val); break;
+    case REG_PORTC: writePort(PORT_C, val); break;
+    case REG_PORTD: writePort(PORT_D, val); break;
+    case REG_PCICR: pcicr = val; serviceInterrupts(); break;
+    // Writing a one to a flag clears it
+    case REG_PCIFR: pcifr &= ~val; break;
+    case REG_PCMSK0: pcmsk[0] = val; break;
+    case REG_PCMSK1: pcmsk[1] = val; break;
+    case REG_PCMSK2: pcmsk[2] = val; break;
+    case REG_SREG: setInterruptsEnabled(val & _BV(SREG_I)); break;
+    case REG_TIMSK0:
+      if (val & ~timsk0 & _BV(OCIE0B))
+        startOePulsing();
+      timsk0 = val;
+      serviceInterrupts();
+      break;
+    case REG_TIFR0: tifr0 &= ~val; break;
+    case REG_TCCR0A: writeTccr0a(val); break;
+    case REG_TCCR1A: tccr1a = val; break;
+    case REG_TCCR1B: tccr1b = val; break;
+    case REG_TWBR: twbr = val; break;
+    // Only the prescaler bits are writable
+    case REG_TWSR: twsr = (twsr & ~0x03) | (val & 0x03); break;
+    case REG_TWDR: twdr = val; break;
+    case REG_TWCR: writeTwcr(val); break;
+    default: break;
+  }
+}
+
+/**
+ * TCNT1 follows virtual time when Timer1 runs undivided with ICR1 as TOP,
+ * the only way the sketch sets it up. Code between two reads takes no
+ * virtual time, so the cycle counts taken from it are zero on the host.
+ */
+uint16_t HostBoard::readRegister16(uint8_t id)
+{
+  if (id == REG_TCNT1)
+  {
+    if ((tccr1b & 0x07) != _BV(CS10))
+      return timer1[REG_TCNT1];
+
+    return timerNow() * (F_CPU / 1000000L) % ((uint32_t) timer1[REG_ICR1] + 1);
+  }
+
+  return id < NUM_HOST_REGISTERS16 ? timer1[id] : 0;
+}
+
+void HostBoard::writeRegister16(uint8_t id, uint16_t val)
+{
+  if (id < NUM_HOST_REGISTERS16)
+    timer1[id] = val;
+}
+
+void HostBoard::setInterruptsEnabled(bool value)
+{
+  interruptsEnabled = value;
+
+  if (interruptsEnabled)
+    serviceInterrupts();
+}
+
+void HostBoard::setTone(uint8_t pin, unsigned int frequency, uint64_t duration)
+{
+  if (frequency)
+    stats.tones++;
+
+  toneFrequency = frequency;
+  toneOffMicros = (frequency && duration) ? micros + duration : 0;
+  notify();
+}
+
+/**
+ * Bytes arriving while the port is closed or its buffer is full are lost,
+ * as on the hardware.
+ */
+void HostBoard::setSerialOpen(bool open)
+{
+  serialOpen = open;
+  serialCount = 0;
+}
+
+void HostBoard::receiveSerial(uint8_t value)
+{
+  if (!serialOpen || serialCount == HOST_SERIAL_BUFFER)
+  {
+    stats.serialDropped++;
+    return;
+  }
+
+  serialBuffer[(serialHead + serialCount++) % HOST_SERIAL_BUFFER] = value;
+  stats.serialBytes++;
+}
+
+int HostBoard::readSerial()
+{
+  if (serialCount == 0)
+    return -1;
+
+  uint8_t value = serialBuffer[serialHead];
+
+  serialHead = (serialHead + 1) % HOST_SERIAL_BUFFER;
+  serialCount--;
+
+  return value;
+}
+
+/**
+ * The tubes count as lit while OE_PIN is low, or while the firmware is
+ * pulsing it from the Timer0 compare B interrupt: a filament glows through
+ * the gaps between PWM pulses.
+ */
+bool HostBoard::getTubesLit()
+{
+  if (!(portDdr[pinToPort(OE_PIN)] & pinToBit(OE_PIN)))
+    return false;
+
+  return !readPin(OE_PIN) || (timsk0 & _BV(OCIE0B));
+}
+
+/**
+ * Returns the fraction of time OE_PIN held the tubes on, averaged over the
+ * last brightness window that was pulsed throughout, while it is being
+ * pulsed.
+ */
+double HostBoard::getTubeBrightness()
+{
+  if (!getTubesLit())
+    return 0;
+
+  if (!(timsk0 & _BV(OCIE0B)))
+    return 1;
+
+  accumulateOe(!readPin(OE_PIN));
+  return oeDutyValid ? oeDuty : 1;
+}
+
+uint8_t HostBoard::readPort(uint8_t port)
+{
+  uint8_t ddr = portDdr[port];
+  uint8_t out = portOut[port];
+  uint8_t driven = extDriven[port];
+  uint8_t input = (driven & extLevel[port]) | (~driven & out);
+
+  return (out & ddr) | (input & ~ddr);
+}
+
+void HostBoard::writePort(uint8_t port, uint8_t val)
+{
+  uint8_t changed = (portOut[port] ^ val) & portDdr[port];
+
+  portOut[port] = val;
+
+  for (uint8_t i = 0; changed; i++, changed >>= 1)
+  {
+    if (changed & 0x01)
+      outputChanged(portBitToPin(port, i), (val >> i) & 0x01);
+  }
+
+  if (port == PORT_D)
+    checkPinChange();
+}
+
+/**
+ * Models what is wired to the output pins: the 74HC595 chain clocks and
+ * latches on rising edges of CLK_PIN and LATCH_PIN, and a stalled I2C slave
+ * counts SCL pulses while the TWI is disabled.
+ */
+void HostBoard::outputChanged(uint8_t pin, uint8_t level)
+{
+  switch (pin)
+  {
+    case CLK_PIN:
+      if (level)
+      {
+        shiftRegister = (shiftRegister << 1) | readPin(DATA_PIN);
+        stats.shiftClocks++;
+      }
+      break;
+
+    case LATCH_PIN:
+      if (level)
+      {
+        latchedFrame = shiftRegister;
+        stats.latches++;
+        notify();
+      }
+      break;
+
+    case HOST_SCL_PIN:
+      // A stalled slave lets go of SDA once it has been clocked enough
+      if (level && twiStallClocks && --twiStallClocks == 0)
+        driveInput(HOST_SDA_PIN, false, LOW);
+      break;
+
+    case OE_PIN:
+      // Until now OE_PIN was the opposite of level
+      accumulateOe(level);
+      notify();
+      break;
+
+    case HOST_AMPM_PIN:
+    case HOST_ALRM_PIN:
+      notify();
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * Brings the current window up to date before the firmware starts pulsing
+ * OE_PIN, so that windows closing from now on know whether they were pulsed
+ * all the way through.
+ */
+void HostBoard::startOePulsing()
+{
+  accumulateOe(!readPin(OE_PIN));
+  oePulsedMicros = micros;
+}
+
+/**
+ * Adds the time since the last call, during which OE_PIN was low or not, to
+ * the current brightness window, closing the window first if it has ended.
+ * Windows are aligned to multiples of HOST_OE_WINDOW_MICROS.
+ */
+void HostBoard::accumulateOe(bool low)
+{
+  uint64_t windowEnd = oeWindowMicros + HOST_OE_WINDOW_MICROS;
+
+  if (micros >= windowEnd)
+  {
+    if (low)
+      oeLowMicros += windowEnd - oeLastMicros;
+
+    // Only windows pulsed from start to end give a meaningful average;
+    // the tubes keep their last brightness across a blink
+    if (oePulsedMicros <= oeWindowMicros && (timsk0 & _BV(OCIE0B)))
+    {
+      oeDuty = (double) oeLowMicros / HOST_OE_WINDOW_MICROS;
+      oeDutyValid = true;
+    }
+
+    oeWindowMicros = micros - micros % HOST_OE_WINDOW_MICROS;
+    oeLastMicros = oeWindowMicros;
+    oeLowMicros = 0;
+  }
+
+  if (low)
+    oeLowMicros += micros - oeLastMicros;
+
+  oeLastMicros = micros;
+}
+
+void HostBoard::checkPinChange()
+{
+  uint8_t pind = readPort(PORT_D);
+  uint8_t changed = pind ^ lastPind;
+
+  lastPind = pind;
+
+  if (changed & pcmsk[2])
+  {
+    pcifr |= _BV(PCIF2);
+    serviceInterrupts();
+  }
+}
+
+/**
+ * The compare A and B flags are each raised once per Timer0 period. They are
+ * only scheduled while their interrupts are enabled, since nothing polls them.
+ */
+uint64_t HostBoard::nextTimer0Micros()
+{
+  if (!(timsk0 & (_BV(OCIE0A) | _BV(OCIE0B))))
+    return HOST_NEVER;
+
+  if (sleeping && sleepMode == SLEEP_MODE_PWR_DOWN)
+    return HOST_NEVER;
+
+  return (micros / HOST_TIMER0_PERIOD_MICROS + 1) * HOST_TIMER0_PERIOD_MICROS;
+}
+
+/**
+ * Runs pending interrupts in hardware priority order (lowest vector number
+ * first). Interrupts are disabled while a handler runs, as on the AVR.
+ */
+void HostBoard::serviceInterrupts()
+{
+  while (interruptsEnabled && !inIsr)
+  {
+    inIsr = true;
+    interruptsEnabled = false;
+
+    if (pcifr & pcicr & _BV(PCIF2))
+    {
+      pcifr &= ~_BV(PCIF2);
+      stats.isrCalls++;
+      PCINT2_vect();
+    }
+    else if (tifr0 & timsk0 & _BV(OCF0A))
+    {
+      tifr0 &= ~_BV(OCF0A);
+      stats.timerIsrCalls++;
+      TIMER0_COMPA_vect();
+    }
+    else if (tifr0 & timsk0 & _BV(OCF0B))
+    {
+      tifr0 &= ~_BV(OCF0B);
+      stats.timerIsrCalls++;
+      TIMER0_COMPB_vect();
+    }
+    else if ((twcr & (_BV(TWINT) | _BV(TWIE) | _BV(TWEN))) == (_BV(TWINT) | _BV(TWIE) | _BV(TWEN)))
+    {
+      // TWINT is not cleared by running the handler
+      stats.twiIsrCalls++;
+      TWI_vect();
+    }
+    else
+    {
+      interruptsEnabled = true;
+      inIsr = false;
+      break;
+    }
+
+    interruptsEnabled = true;
+    inIsr = false;
+    woken |= sleeping;
+  }
+}
+
+/**
+ * When a speed is set, sleeps so that virtual time runs at most that many
+ * times faster than wall time.
+ */
+void HostBoard::pace()
+{
+  if (speed <= 0)
+    return;
+
+  uint64_t due = startWallMicros + (uint64_t) (micros / speed);
+  uint64_t wall = wallMicros();
+
+  if (due > wall)
+    usleep(due - wall);
+}
+
+void HostBoard::notify()
+{
+  if (outputListener)
+    outputListener();
+}
+
+HostBoard Board;
+
+/*******************************************************************************
+ *
+ * Registers and Interrupts
+ *
+ ******************************************************************************/
+
+HostRegister PINB(REG_PINB), DDRB(REG_DDRB), PORTB(REG_PORTB);
+HostRegister PINC(REG_PINC), DDRC(REG_DDRC), PORTC(REG_PORTC);
+HostRegister PIND(REG_PIND), DDRD(REG_DDRD), PORTD(REG_PORTD);
+HostRegister PCICR(REG_PCICR), PCIFR(REG_PCIFR);
+HostRegister PCMSK0(REG_PCMSK0), PCMSK1(REG_PCMSK1), PCMSK2(REG_PCMSK2);
+HostRegister SREG(REG_SREG);
+HostRegister TIMSK0(REG_TIMSK0), TIFR0(REG_TIFR0), TCCR0A(REG_TCCR0A);
+HostRegister TCCR1A(REG_TCCR1A), TCCR1B(REG_TCCR1B);
+HostRegister16 ICR1(REG_ICR1), OCR1A(REG_OCR1A), OCR1B(REG_OCR1B), TCNT1(REG_TCNT1);
+HostRegister TWBR(REG_TWBR), TWSR(REG_TWSR), TWDR(REG_TWDR), TWCR(REG_TWCR);
+
+uint8_t hostReadRegister(uint8_t id)
+{
+  return Board.readRegister(id);
+}
+
+void hostWriteRegister(uint8_t id, uint8_t val)
+{
+  Board.writeRegister(id, val);
+}
+
+uint16_t hostReadRegister16(uint8_t id)
+{
+  return Board.readRegister16(id);
+}
+
+void hostWriteRegister16(uint8_t id, uint16_t val)
+{
+  Board.writeRegister16(id, val);
+}
+
+void sei()
+{
+  Board.setInterruptsEnabled(true);
+}
+
+void cli()
+{
+  Board.setInterruptsEnabled(false);
+}
+
+void set_sleep_mode(uint8_t mode)
+{
+  Board.setSleepMode(mode);
+}
+
+void sleep_enable()
+{
+  Board.setSleepEnabled(true);
+}
+
+void sleep_disable()
+{
+  Board.setSleepEnabled(false);
+}
+
+void sleep_cpu()
+{
+  Board.sleep();
+}
+
+void sleep_bod_disable()
+{
+}
+
+// Overridden by the firmware's ISRs; lets host tools link without a sketch
+extern "C" void __attribute__((weak)) PCINT2_vect(void)
+{
+}
+
+extern "C" void __attribute__((weak)) TIMER0_COMPA_vect(void)
+{
+}
+
+extern "C" void __attribute__((weak)) TIMER0_COMPB_vect(void)
+{
+}
+
+extern "C" void __attribute__((weak)) TWI_vect(void)
+{
+}
+
+/*******************************************************************************
+ *
+ * Arduino Core
+ *
+ ******************************************************************************/
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  Board.setPinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  Board.writePin(pin, val);
+}
+
+int digitalRead(uint8_t pin)
+{
+  return Board.readPin(pin);
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+  Board.writePwm(pin, constrain(val, 0, 255));
+}
+
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)
+{
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    if (bitOrder == LSBFIRST)
+      digitalWrite(dataPin, !!(val & (1 << i)));
+    else
+      digitalWrite(dataPin, !!(val & (1 << (7 - i))));
+
+    digitalWrite(clockPin, HIGH);
+    digitalWrite(clockPin, LOW);
+  }
+}
+
+unsigned long millis()
+{
+  return Board.timerNow() / 1000;
+}
+
+unsigned long micros()
+{
+  return Board.timerNow();
+}
+
+void delay(unsigned long ms)
+{
+  Board.advance((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  Board.advance(us);
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+  Board.setTone(pin, frequency, (uint64_t) duration * 1000);
+}
+
+void noTone(uint8_t pin)
+{
+  Board.setTone(pin, 0, 0);
+}
+
+/*******************************************************************************
+ *
+ * Serial
+ *
+ ******************************************************************************/
+
+void HardwareSerial::begin(unsigned long baud)
+{
+  Board.setSerialOpen(true);
+}
+
+void HardwareSerial::end()
+{
+  Board.setSerialOpen(false);
+}
+
+int HardwareSerial::available()
+{
+  return Board.serialAvailable();
+}
+
+int HardwareSerial::read()
+{
+  return Board.readSerial();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return fputc(c, stderr) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  return fwrite(buffer, 1, size, stderr);
+}
+
+size_t HardwareSerial::print(const char *str)
+{
+  return fprintf(stderr, "%s", str);
+}
+
+size_t HardwareSerial::print(char c)
+{
+  return write((uint8_t) c);
+}
+
+size_t HardwareSerial::print(long n, int base)
+{
+  if (base == 10)
+    return fprintf(stderr, "%ld", n);
+
+  return print((unsigned long) n, base);
+}
+
+size_t HardwareSerial::print(unsigned long n, int base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+
+  *str = '\0';
+
+  if (base < 2)
+    base = 10;
+
+  do
+  {
+    unsigned long m = n;
+    n /= base;
+    char c = m - base * n;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+
+  return print(str);
+}
+
+size_t HardwareSerial::print(double n, int digits)
+{
+  return fprintf(stderr, "%.*f", digits, n);
+}
+
+size_t HardwareSerial::println()
+{
+  return print("\r\n");
+}
+
+HardwareSerial Serial;
@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Register level model of the ATmega328P's TWI in master mode. Each START,
+ * address or data byte takes as long as it would on the wire at the bit rate
+ * set by TWBR and TWSR, then raises TWINT with the status code the hardware
+ * would report. Bytes written to a slave are delivered to its HostI2CDevice
+ * when the write ends with a STOP or repeated START; reads fetch one byte at
+ * a time.
+ */
+
+#include <util/twi.h>
+
+#include "Host.h"
+
+#define TWI_IDLE 0
+#define TWI_STARTED 1
+#define TWI_WRITING 2
+#define TWI_READING 3
+#define TWI_NACKED 4
+
+/**
+ * Makes a slave hang mid-byte holding SDA low, as happens when the master
+ * resets during a read. The transfer in progress never completes, and no
+ * START can be sent until the slave has seen the given number of SCL pulses.
+ */
+void HostBoard::stallI2C(uint8_t clocks)
+{
+  twiStallClocks = max(clocks, 1);
+  twiMicros = 0;
+  driveInput(HOST_SDA_PIN, true, LOW);
+}
+
+void HostBoard::writeTwcr(uint8_t val)
+{
+  // Writing a one to TWINT clears it and starts the next operation
+  bool go = val & _BV(TWINT);
+
+  twcr = (val & ~_BV(TWINT)) | (go ? 0 : twcr & _BV(TWINT));
+
+  // Disabling the TWI abandons any transfer and hands the pins to the port
+  if (!(twcr & _BV(TWEN)))
+  {
+    twiState = TWI_IDLE;
+    twiLength = 0;
+    twiMicros = 0;
+    return;
+  }
+
+  if (!go)
+  {
+    serviceInterrupts();
+    return;
+  }
+
+  if (twcr & _BV(TWSTO))
+  {
+    twiStop();
+    twcr &= ~_BV(TWSTO);
+  }
+
+  if (twcr & _BV(TWSTA))
+    twiStart();
+  else if (twiState != TWI_IDLE)
+    twiByte();
+}
+
+void HostBoard::twiStart()
+{
+  bool repeated = twiState != TWI_IDLE;
+
+  twiStop();
+  twiState = TWI_STARTED;
+  twiResult = repeated ? TW_REP_START : TW_START;
+
+  // A slave holding SDA low keeps the bus busy
+  twiMicros = twiStallClocks ? 0 : micros + twiTransferMicros(1);
+}
+
+void HostBoard::twiByte()
+{
+  switch (twiState)
+  {
+    case TWI_STARTED:
+    {
+      bool read = twdr & TW_READ;
+
+      twiDevice = getI2CDevice(twdr >> 1);
+      stats.i2cTransactions++;
+      stats.i2cBytes++;
+
+      if (twiDevice)
+      {
+        twiState = read ? TWI_READING : TWI_WRITING;
+        twiResult = read ? TW_MR_SLA_ACK : TW_MT_SLA_ACK;
+      }
+      else
+      {
+        stats.i2cErrors++;
+        twiState = TWI_NACKED;
+        twiResult = read ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+      }
+      break;
+    }
+
+    case TWI_WRITING:
+      stats.i2cBytes++;
+
+      if (twiLength < HOST_TWI_BUFFER)
+        twiBuffer[twiLength++] = twdr;
+
+      twiResult = TW_MT_DATA_ACK;
+      break;
+
+    case TWI_READING:
+      stats.i2cBytes++;
+      twiDevice->transmit(&twiData, 1);
+      twiResult = (twcr & _BV(TWEA)) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+      break;
+
+    default:
+      // Only a STOP or START makes sense after a NACKed address
+      return;
+  }
+
+  twiMicros = twiStallClocks ? 0 : micros + twiTransferMicros(9);
+}
+
+void HostBoard::twiStop()
+{
+  if (twiState == TWI_WRITING && !twiDevice->receive(twiBuffer, twiLength))
+    stats.i2cErrors++;
+
+  twiState = TWI_IDLE;
+  twiLength = 0;
+  twiMicros = 0;
+}
+
+void HostBoard::twiComplete()
+{
+  twiMicros = 0;
+  twsr = (twsr & 0x03) | twiResult;
+
+  if (twiResult == TW_MR_DATA_ACK || twiResult == TW_MR_DATA_NACK)
+    twdr = twiData;
+
+  twcr |= _BV(TWINT);
+  serviceInterrupts();
+}
+
+/**
+ * SCL runs at F_CPU / (16 + 2 * TWBR * 4^TWPS).
+ */
+uint64_t HostBoard::twiTransferMicros(uint8_t bits)
+{
+  uint64_t cycles = 16 + 2 * (uint64_t) twbr * (1 << (2 * (twsr & 0x03)));
+
+  return max((bits * cycles + F_CPU / 2000000) / (F_CPU / 1000000), (uint64_t) 1);
+}
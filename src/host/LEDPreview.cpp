@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Plays a pattern from LEDPattern.cpp through the firmware's own
+ * PatternPlayer and prints the four LED levels over time, either as
+ * numbers or as bars, so a new pattern can be checked before it goes on
+ * the clock. Columns are in SECONDS0_PIN to SECONDS3_PIN order, left to
+ * right as on the board.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "LEDPattern.h"
+
+#define BAR_WIDTH 16 // Characters for a full brightness bar
+
+struct NamedPattern
+{
+  const char *name;
+  const LEDPattern *pattern;
+};
+
+static const NamedPattern patterns[] = {
+  { "breathe", &BREATHE_PATTERN },
+  { "rolling", &ROLLING_BREATHE_PATTERN },
+  { "heartbeat", &HEARTBEAT_PATTERN }
+};
+
+#define NUM_PATTERNS (sizeof(patterns) / sizeof(patterns[0]))
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+      "Usage: %s [options] [PATTERN]\n"
+      "  --step MS           time between samples (default 50)\n"
+      "  --length MS         time to preview (default one period)\n"
+      "  --bars              draw levels as bars instead of numbers\n"
+      "PATTERN is one of:",
+      name);
+
+  for (unsigned i = 0; i < NUM_PATTERNS; i++)
+    fprintf(stderr, " %s", patterns[i].name);
+
+  fprintf(stderr, " (default rolling)\n");
+}
+
+static void printBar(uint8_t level)
+{
+  int width = (level * BAR_WIDTH + 127) / 255;
+
+  printf(" |");
+
+  for (int i = 0; i < BAR_WIDTH; i++)
+    putchar(i < width ? '#' : ' ');
+
+  putchar('|');
+}
+
+int main(int argc, char **argv)
+{
+  const LEDPattern *pattern = &ROLLING_BREATHE_PATTERN;
+  unsigned long step = 50;
+  unsigned long length = 0;
+  bool bars = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--step") == 0 && i + 1 < argc)
+    {
+      step = strtoul(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc)
+    {
+      length = strtoul(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "--bars") == 0)
+    {
+      bars = true;
+    }
+    else
+    {
+      unsigned p = 0;
+
+      while (p < NUM_PATTERNS && strcmp(argv[i], patterns[p].name) != 0)
+        p++;
+
+      if (p == NUM_PATTERNS)
+      {
+        usage(argv[0]);
+        return 1;
+      }
+
+      pattern = patterns[p].pattern;
+    }
+  }
+
+  if (step == 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (length == 0)
+    length = pattern->period;
+
+  PatternPlayer player;
+  player.start(pattern);
+
+  for (unsigned long t = 0; t < length; t += step)
+  {
+    if (t > 0)
+      player.advance(step);
+
+    printf("%6lu", t);
+
+    for (uint8_t i = 0; i < NUM_LED_TRACKS; i++)
+    {
+      if (bars)
+        printBar(player.getLevel(i));
+      else
+        printf(" %3u", player.getLevel(i));
+    }
+
+    printf("\n");
+  }
+
+  return 0;
+}
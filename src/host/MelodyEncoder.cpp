@@ -0,0 +1,599 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Turns a score into the packed melody format described in Melody.cpp and
+ * prints it as C source for Melody.cpp, as raw bytes, or as a custom alarm
+ * melody record ready to send to a clock in upload mode (see MelodyUpload.h).
+ * It also writes the alarm records that set the other alarm slots, and the
+ * night records that set when and how far the display dims.
+ *
+ * A score is either an RTTTL ringtone ("name:d=4,o=5,b=120:8e6,8d6,4f#5")
+ * or a list of NOTE:DURATION pairs, e.g. "A4:QT CS5:QT E5:QT R:E BEEP:ET",
+ * where DURATION is one of the DUR_* names from Melody.h. RTTTL durations
+ * are rounded to the nearest DUR_* value, since the player has no tempo.
+ * Note names and frequencies come from the firmware's own note table.
+ */
+
+#include <string>
+#include <vector>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/crc16.h>
+
+#include "Melody.h"
+#include "MelodyUpload.h"
+#include "AlarmSchedule.h"
+#include "Display.h"
+
+struct Note
+{
+  uint8_t code;
+  uint8_t duration;
+};
+
+static const char *durationNames[NUM_DURATION_CODES] = {
+  "WH", "H", "DQ", "Q", "QT", "DE", "E", "ET"
+};
+
+static const char *semitoneNames[12] = {
+  "C", "CS", "D", "DS", "E", "F", "FS", "G", "GS", "A", "AS", "B"
+};
+
+static void fail(const char *format, const char *detail)
+{
+  fprintf(stderr, "melody-encoder: ");
+  fprintf(stderr, format, detail);
+  fprintf(stderr, "\n");
+  exit(1);
+}
+
+/**
+ * Returns the note code for a semitone (0 = C) in an octave. Code 1 is B0.
+ */
+static uint8_t chromaticCode(int semitone, int octave, const char *token)
+{
+  int code = octave * 12 + semitone - 10;
+
+  if (code < 1 || code >= NOTE_CODE_BEEP)
+    fail("note out of range: %s", token);
+
+  return code;
+}
+
+static int parseSemitone(char letter)
+{
+  static const int semitones[7] = {9, 11, 0, 2, 4, 5, 7}; // A to G
+
+  letter = toupper(letter);
+
+  if (letter == 'H')
+    letter = 'B';
+
+  return (letter >= 'A' && letter <= 'G') ? semitones[letter - 'A'] : -1;
+}
+
+/**
+ * Picks the duration code closest to ms on a logarithmic scale.
+ */
+static uint8_t nearestDuration(double ms)
+{
+  uint8_t best = 0;
+
+  for (uint8_t i = 1; i < NUM_DURATION_CODES; i++)
+  {
+    if (fabs(log(ms / durationMillis(i))) < fabs(log(ms / durationMillis(best))))
+      best = i;
+  }
+
+  return best;
+}
+
+/**
+ * Parses "A4:QT", "CS5:E", "C#5:E", "R:Q" or "BEEP:ET".
+ */
+static Note parsePair(const std::string &token)
+{
+  size_t colon = token.find(':');
+
+  if (colon == std::string::npos)
+    fail("expected NOTE:DURATION, got %s", token.c_str());
+
+  std::string name = token.substr(0, colon);
+  std::string duration = token.substr(colon + 1);
+  Note note;
+
+  for (size_t i = 0; i < name.size(); i++)
+    name[i] = toupper(name[i]);
+
+  for (size_t i = 0; i < duration.size(); i++)
+    duration[i] = toupper(duration[i]);
+
+  if (name == "R" || name == "RST")
+  {
+    note.code = NOTE_CODE_RST;
+  }
+  else if (name == "BEEP")
+  {
+    note.code = NOTE_CODE_BEEP;
+  }
+  else
+  {
+    int semitone = parseSemitone(name[0]);
+    size_t i = 1;
+
+    if (semitone < 0)
+      fail("unknown note: %s", token.c_str());
+
+    if (i < name.size() && (name[i] == 'S' || name[i] == '#'))
+    {
+      semitone++;
+      i++;
+    }
+
+    if (i + 1 != name.size() || !isdigit(name[i]))
+      fail("bad octave: %s", token.c_str());
+
+    note.code = chromaticCode(semitone, name[i] - '0', token.c_str());
+  }
+
+  for (note.duration = 0; note.duration < NUM_DURATION_CODES; note.duration++)
+  {
+    if (duration == durationNames[note.duration])
+      break;
+  }
+
+  if (note.duration == NUM_DURATION_CODES)
+    fail("unknown duration: %s", token.c_str());
+
+  return note;
+}
+
+static std::vector<std::string> split(const std::string &text, const char *separators)
+{
+  std::vector<std::string> tokens;
+  size_t start = 0;
+
+  while ((start = text.find_first_not_of(separators, start)) != std::string::npos)
+  {
+    size_t end = text.find_first_of(separators, start);
+
+    tokens.push_back(text.substr(start, end - start));
+    start = end;
+  }
+
+  return tokens;
+}
+
+static std::vector<Note> parsePairs(const std::string &score)
+{
+  std::vector<Note> notes;
+  std::vector<std::string> tokens = split(score, " \t\r\n,");
+
+  for (size_t i = 0; i < tokens.size(); i++)
+    notes.push_back(parsePair(tokens[i]));
+
+  return notes;
+}
+
+/**
+ * Parses an RTTTL ringtone, filling in name from its title.
+ */
+static std::vector<Note> parseRtttl(const std::string &score, std::string *name)
+{
+  size_t first = score.find(':');
+  size_t second = score.find(':', first + 1);
+  int defaultDuration = 4;
+  int defaultOctave = 6;
+  int bpm = 63;
+
+  *name = split(score.substr(0, first), " \t\r\n").at(0);
+
+  std::vector<std::string> defaults = split(score.substr(first + 1, second - first - 1), " \t\r\n,");
+
+  for (size_t i = 0; i < defaults.size(); i++)
+  {
+    const char *value = defaults[i].c_str() + 2;
+
+    if (defaults[i].compare(0, 2, "d=") == 0)
+      defaultDuration = atoi(value);
+    else if (defaults[i].compare(0, 2, "o=") == 0)
+      defaultOctave = atoi(value);
+    else if (defaults[i].compare(0, 2, "b=") == 0)
+      bpm = atoi(value);
+    else
+      fail("unknown RTTTL default: %s", defaults[i].c_str());
+  }
+
+  if (defaultDuration <= 0 || bpm <= 0)
+    fail("bad RTTTL defaults: %s", score.substr(first + 1, second - first - 1).c_str());
+
+  std::vector<Note> notes;
+  std::vector<std::string> tokens = split(score.substr(second + 1), " \t\r\n,");
+
+  for (size_t t = 0; t < tokens.size(); t++)
+  {
+    const char *p = tokens[t].c_str();
+    int duration = defaultDuration;
+    int octave = defaultOctave;
+    bool dotted = false;
+    Note note;
+
+    if (isdigit(*p))
+      duration = strtol(p, (char**) &p, 10);
+
+    if (tolower(*p) == 'p')
+    {
+      note.code = NOTE_CODE_RST;
+      p++;
+    }
+    else
+    {
+      int semitone = parseSemitone(*p);
+
+      if (semitone < 0)
+        fail("unknown RTTTL note: %s", tokens[t].c_str());
+
+      p++;
+
+      if (*p == '#')
+      {
+        semitone++;
+        p++;
+      }
+
+      if (*p == '.')
+      {
+        dotted = true;
+        p++;
+      }
+
+      if (isdigit(*p))
+        octave = *p++ - '0';
+
+      note.code = chromaticCode(semitone, octave, tokens[t].c_str());
+    }
+
+    if (*p == '.')
+    {
+      dotted = true;
+      p++;
+    }
+
+    if (*p != '\0' || duration <= 0)
+      fail("bad RTTTL note: %s", tokens[t].c_str());
+
+    double ms = 60000.0 / bpm * 4 / duration * (dotted ? 1.5 : 1);
+
+    note.duration = nearestDuration(ms);
+    notes.push_back(note);
+  }
+
+  return notes;
+}
+
+/**
+ * Packs notes, adding a duration byte wherever the duration changes and at
+ * both ends.
+ */
+static std::vector<uint8_t> encode(const std::vector<Note> &notes)
+{
+  std::vector<uint8_t> data;
+  uint8_t duration = notes.front().duration;
+
+  data.push_back(MELODY_DURATION(duration, duration));
+
+  for (size_t i = 0; i < notes.size(); i++)
+  {
+    if (notes[i].duration != duration)
+    {
+      data.push_back(MELODY_DURATION(duration, notes[i].duration));
+      duration = notes[i].duration;
+    }
+
+    data.push_back(notes[i].code);
+  }
+
+  data.push_back(MELODY_DURATION(duration, duration));
+
+  return data;
+}
+
+static std::string describeNote(const Note &note)
+{
+  std::string text;
+
+  if (note.code == NOTE_CODE_RST)
+  {
+    text = "R";
+  }
+  else if (note.code == NOTE_CODE_BEEP)
+  {
+    text = "BEEP";
+  }
+  else
+  {
+    int semitone = note.code + 10;
+
+    text = semitoneNames[semitone % 12];
+    text += (char) ('0' + semitone / 12);
+  }
+
+  return text + ":" + durationNames[note.duration];
+}
+
+static void printSource(const std::string &name, const std::vector<Note> &notes,
+    const std::vector<uint8_t> &data)
+{
+  std::string id;
+
+  for (size_t i = 0; i < name.size(); i++)
+    id += isalnum(name[i]) ? toupper(name[i]) : '_';
+
+  printf("//");
+
+  for (size_t i = 0, column = 2; i < notes.size(); i++)
+  {
+    std::string note = describeNote(notes[i]);
+
+    if (column + note.size() + 1 > 78)
+    {
+      printf("\n//");
+      column = 2;
+    }
+
+    printf(" %s", note.c_str());
+    column += note.size() + 1;
+  }
+
+  printf("\nstatic constexpr uint8_t %s_DATA[] PROGMEM = {", id.c_str());
+
+  for (size_t i = 0; i < data.size(); i++)
+    printf("%s0x%02x%s", i % 12 ? " " : "\n  ", data[i], i + 1 < data.size() ? "," : "");
+
+  printf("\n};\nconst Melody %s_MELODY PROGMEM = {%s_DATA, sizeof(%s_DATA)};\n",
+      id.c_str(), id.c_str(), id.c_str());
+}
+
+/**
+ * Wraps a packed melody in the header the clock checks before storing it.
+ */
+static std::vector<uint8_t> makeRecord(const std::vector<uint8_t> &data)
+{
+  if (data.size() > CUSTOM_MELODY_MAX_SIZE)
+  {
+    char limit[16];
+    snprintf(limit, sizeof(limit), "%d", CUSTOM_MELODY_MAX_SIZE);
+    fail("too long for a custom melody, which takes at most %s bytes", limit);
+  }
+
+  uint8_t crc = _crc_ibutton_update(0, data.size());
+
+  for (size_t i = 0; i < data.size(); i++)
+    crc = _crc_ibutton_update(crc, data[i]);
+
+  std::vector<uint8_t> record;
+
+  record.push_back(CUSTOM_MELODY_MAGIC);
+  record.push_back(data.size());
+  record.push_back(crc);
+  record.insert(record.end(), data.begin(), data.end());
+
+  return record;
+}
+
+/**
+ * Parses "SLOT,HH:MM[,DAYS][,once]" or "SLOT,off", where DAYS lists the days
+ * of the week by number (e.g. 12345), and returns the alarm record.
+ */
+static std::vector<uint8_t> makeAlarmRecord(const char *spec)
+{
+  std::vector<std::string> fields = split(spec, ",");
+  Alarm alarm = {0, 0, ALARM_EVERY_DAY, ALARM_ENABLED};
+  unsigned int slot, hour, minute;
+
+  if (fields.size() < 2 || sscanf(fields[0].c_str(), "%u", &slot) != 1 || slot >= MAX_ALARMS)
+    fail("bad alarm: %s", spec);
+
+  if (fields[1] == "off")
+  {
+    alarm.days = 0;
+    alarm.flags = 0;
+  }
+  else if (sscanf(fields[1].c_str(), "%u:%u", &hour, &minute) == 2 && hour < 24 && minute < 60)
+  {
+    alarm.hour = hour;
+    alarm.minute = minute;
+  }
+  else
+  {
+    fail("bad alarm time: %s", spec);
+  }
+
+  for (size_t i = 2; i < fields.size(); i++)
+  {
+    if (fields[i] == "once")
+    {
+      alarm.flags |= ALARM_ONE_SHOT;
+      continue;
+    }
+
+    alarm.days = 0;
+
+    for (size_t j = 0; j < fields[i].size(); j++)
+    {
+      if (fields[i][j] < '1' || fields[i][j] > '7')
+        fail("bad alarm days: %s", spec);
+
+      alarm.days |= 1 << (fields[i][j] - '1');
+    }
+  }
+
+  uint8_t record[ALARM_RECORD_SIZE] = {
+    ALARM_RECORD_MAGIC, (uint8_t) slot, alarm.hour, alarm.minute, alarm.days, alarm.flags, 0
+  };
+
+  for (uint8_t i = 1; i < ALARM_RECORD_SIZE - 1; i++)
+    record[ALARM_RECORD_SIZE - 1] = _crc_ibutton_update(record[ALARM_RECORD_SIZE - 1], record[i]);
+
+  return std::vector<uint8_t>(record, record + ALARM_RECORD_SIZE);
+}
+
+/**
+ * Parses "HH,HH,LEVEL", the hours the display dims from and until on the 24
+ * hour clock and its brightness in between, and returns the night record.
+ */
+static std::vector<uint8_t> makeNightRecord(const char *spec)
+{
+  unsigned int start, end, level;
+  char extra;
+
+  if (sscanf(spec, "%u,%u,%u%c", &start, &end, &level, &extra) != 3 || start > 23 ||
+      end > 23 || level > DISPLAY_BRIGHTNESS_LEVELS)
+    fail("bad night profile: %s", spec);
+
+  uint8_t record[NIGHT_RECORD_SIZE] = {
+    NIGHT_RECORD_MAGIC, (uint8_t) start, (uint8_t) end, (uint8_t) level, 0
+  };
+
+  for (uint8_t i = 1; i < NIGHT_RECORD_SIZE - 1; i++)
+    record[NIGHT_RECORD_SIZE - 1] = _crc_ibutton_update(record[NIGHT_RECORD_SIZE - 1], record[i]);
+
+  return std::vector<uint8_t>(record, record + NIGHT_RECORD_SIZE);
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+      "Usage: %s [options] [FILE]\n"
+      "  --name NAME         melody name for the C source (default from RTTTL)\n"
+      "  --binary            write the packed bytes instead of C source\n"
+      "  --upload            write a custom alarm melody record for upload\n"
+      "  --alarm SPEC        write an alarm record for upload instead, SPEC being\n"
+      "                      SLOT,HH:MM[,DAYS][,once] or SLOT,off; DAYS as in 12345\n"
+      "  --night HH,HH,LEVEL write a night record for upload instead, dimming to\n"
+      "                      LEVEL (0-32) from the first hour until the second\n"
+      "Reads an RTTTL ringtone or NOTE:DURATION pairs from FILE or stdin.\n",
+      name);
+}
+
+int main(int argc, char **argv)
+{
+  std::string name = "MELODY";
+  bool binary = false;
+  bool upload = false;
+  FILE *input = stdin;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--name") == 0 && i + 1 < argc)
+    {
+      name = argv[++i];
+    }
+    else if (strcmp(argv[i], "--binary") == 0)
+    {
+      binary = true;
+    }
+    else if (strcmp(argv[i], "--upload") == 0)
+    {
+      upload = true;
+    }
+    else if (strcmp(argv[i], "--alarm") == 0 && i + 1 < argc)
+    {
+      std::vector<uint8_t> record = makeAlarmRecord(argv[++i]);
+      fwrite(&record[0], 1, record.size(), stdout);
+      return 0;
+    }
+    else if (strcmp(argv[i], "--night") == 0 && i + 1 < argc)
+    {
+      std::vector<uint8_t> record = makeNightRecord(argv[++i]);
+      fwrite(&record[0], 1, record.size(), stdout);
+      return 0;
+    }
+    else if (argv[i][0] != '-' && input == stdin)
+    {
+      input = fopen(argv[i], "r");
+
+      if (input == NULL)
+        fail("cannot open %s", argv[i]);
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::string score;
+  char buffer[256];
+
+  while (fgets(buffer, sizeof(buffer), input))
+  {
+    // Drop comments
+    char *hash = strchr(buffer, '#');
+
+    if (hash && (hash == buffer || isspace(hash[-1])))
+      *hash = '\0';
+
+    score += buffer;
+  }
+
+  // RTTTL has a name:defaults:notes header; the defaults include an '='
+  size_t colon = score.find(':');
+  std::vector<Note> notes;
+
+  if (colon != std::string::npos && score.find('=') != std::string::npos)
+  {
+    std::string title;
+
+    notes = parseRtttl(score, &title);
+
+    if (name == "MELODY")
+      name = title;
+  }
+  else
+  {
+    notes = parsePairs(score);
+  }
+
+  if (notes.empty())
+    fail("%s", "empty score");
+
+  std::vector<uint8_t> data = encode(notes);
+
+  if (upload)
+  {
+    std::vector<uint8_t> record = makeRecord(data);
+    fwrite(&record[0], 1, record.size(), stdout);
+  }
+  else if (binary)
+  {
+    fwrite(&data[0], 1, data.size(), stdout);
+  }
+  else
+  {
+    printSource(name, notes, data);
+  }
+
+  fprintf(stderr, "%u notes in %u bytes (%u unpacked)\n",
+      (unsigned) notes.size(), (unsigned) data.size(), (unsigned) notes.size() * 4);
+
+  return 0;
+}
@@ -0,0 +1,333 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SimDS1307.h"
+
+#define HALF_SECOND 500000ULL
+
+#define REG_SECONDS 0x00
+#define REG_MINUTES 0x01
+#define REG_HOURS 0x02
+#define REG_DAY 0x03
+#define REG_DATE 0x04
+#define REG_MONTH 0x05
+#define REG_YEAR 0x06
+#define REG_CONTROL 0x07
+#define REG_RAM 0x08
+
+#define CH_BIT 0x80
+#define HOUR_12_BIT 0x40
+#define PM_BIT 0x20
+#define CONTROL_OUT 0x80
+#define CONTROL_SQWE 0x10
+#define CONTROL_RS 0x03
+
+static uint8_t toBcd(uint8_t val)
+{
+  return ((val / 10) << 4) | (val % 10);
+}
+
+static uint8_t fromBcd(uint8_t val)
+{
+  return (val >> 4) * 10 + (val & 0x0f);
+}
+
+static uint8_t daysInMonth(uint8_t month, uint8_t year)
+{
+  static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+  if (month == 2 && year % 4 == 0)
+    return 29;
+
+  return days[(month - 1) % 12];
+}
+
+SimDS1307::SimDS1307(uint8_t sqwPin)
+{
+  this->sqwPin = sqwPin;
+  pinLow = false;
+  ticks = 0;
+  lastTickMicros = 0;
+  powerUp();
+}
+
+/**
+ * First power-up: the clock is halted and RAM holds whatever the cells came
+ * up with, here a fixed pseudo-random pattern.
+ */
+void SimDS1307::powerUp()
+{
+  uint32_t seed = 0x1307;
+
+  memset(registers, 0, REG_RAM);
+  registers[REG_SECONDS] = CH_BIT;
+  registers[REG_DAY] = 1;
+  registers[REG_DATE] = 1;
+  registers[REG_MONTH] = 1;
+
+  for (uint8_t i = REG_RAM; i < SIM_DS1307_REGISTERS; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    registers[i] = seed >> 16;
+  }
+
+  pointer = 0;
+  sqwLow = false;
+  nextEdgeMicros = HOST_NEVER;
+  updateSqw();
+}
+
+/**
+ * Starts the clock at the given 24-hour time with the 1 Hz square wave
+ * enabled, as if it had been set before the simulation started.
+ */
+void SimDS1307::setTime(uint8_t hours, uint8_t minutes, uint8_t seconds)
+{
+  registers[REG_SECONDS] = toBcd(seconds);
+  registers[REG_MINUTES] = toBcd(minutes);
+  registers[REG_HOURS] = toBcd(hours);
+  registers[REG_CONTROL] = CONTROL_SQWE;
+  restartCountdown();
+}
+
+bool SimDS1307::load(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+
+  if (!file)
+    return false;
+
+  uint8_t image[SIM_DS1307_REGISTERS];
+  bool ok = fread(image, 1, SIM_DS1307_REGISTERS, file) == SIM_DS1307_REGISTERS;
+  fclose(file);
+
+  if (ok)
+    setRegisters(image);
+
+  return ok;
+}
+
+bool SimDS1307::save(const char *path)
+{
+  FILE *file = fopen(path, "wb");
+
+  if (!file)
+    return false;
+
+  bool ok = fwrite(registers, 1, SIM_DS1307_REGISTERS, file) == SIM_DS1307_REGISTERS;
+  fclose(file);
+
+  return ok;
+}
+
+/**
+ * Replaces every register, as if the DS1307 had been left that way before
+ * the simulation started. A running clock ticks one second later.
+ */
+void SimDS1307::setRegisters(const uint8_t *image)
+{
+  memcpy(registers, image, SIM_DS1307_REGISTERS);
+  restartCountdown();
+}
+
+/**
+ * Falling edges of the square wave while its pin change interrupt was
+ * enabled, which is how many ticks the firmware has counted.
+ */
+uint32_t SimDS1307::getTicks()
+{
+  return ticks;
+}
+
+uint64_t SimDS1307::getLastTickMicros()
+{
+  return lastTickMicros;
+}
+
+uint8_t SimDS1307::getRegister(uint8_t address)
+{
+  return registers[address % SIM_DS1307_REGISTERS];
+}
+
+uint64_t SimDS1307::nextEventMicros()
+{
+  return nextEdgeMicros;
+}
+
+void SimDS1307::fireEvent(uint64_t now)
+{
+  sqwLow = !sqwLow;
+  nextEdgeMicros = now + HALF_SECOND;
+
+  if (sqwLow)
+    tick();
+
+  updateSqw();
+}
+
+/**
+ * A write sets the register pointer from its first byte and stores the rest
+ * with auto-increment, wrapping from the end of RAM back to register 0.
+ */
+bool SimDS1307::receive(const uint8_t *data, uint8_t length)
+{
+  if (length == 0)
+    return true;
+
+  bool secondsWritten = false;
+
+  pointer = data[0] % SIM_DS1307_REGISTERS;
+
+  for (uint8_t i = 1; i < length; i++)
+  {
+    if (pointer == REG_SECONDS)
+      secondsWritten = true;
+
+    registers[pointer] = data[i];
+    pointer = (pointer + 1) % SIM_DS1307_REGISTERS;
+  }
+
+  if (secondsWritten)
+    restartCountdown();
+
+  updateSqw();
+  return true;
+}
+
+uint8_t SimDS1307::transmit(uint8_t *buffer, uint8_t length)
+{
+  for (uint8_t i = 0; i < length; i++)
+  {
+    buffer[i] = registers[pointer];
+    pointer = (pointer + 1) % SIM_DS1307_REGISTERS;
+  }
+
+  return length;
+}
+
+bool SimDS1307::isRunning()
+{
+  return !(registers[REG_SECONDS] & CH_BIT);
+}
+
+/**
+ * Restarts the 1 Hz countdown so that the next increment happens one second
+ * from now. The square wave starts in its low half.
+ */
+void SimDS1307::restartCountdown()
+{
+  sqwLow = true;
+  nextEdgeMicros = isRunning() ? Board.now() + HALF_SECOND : HOST_NEVER;
+  updateSqw();
+}
+
+void SimDS1307::tick()
+{
+  if (!isRunning())
+    return;
+
+  uint8_t seconds = fromBcd(registers[REG_SECONDS]) + 1;
+
+  if (seconds < 60)
+  {
+    registers[REG_SECONDS] = toBcd(seconds);
+    return;
+  }
+
+  registers[REG_SECONDS] = 0;
+
+  uint8_t minutes = fromBcd(registers[REG_MINUTES]) + 1;
+
+  if (minutes < 60)
+  {
+    registers[REG_MINUTES] = toBcd(minutes);
+    return;
+  }
+
+  registers[REG_MINUTES] = 0;
+
+  uint8_t hourReg = registers[REG_HOURS];
+  bool newDay;
+
+  if (hourReg & HOUR_12_BIT)
+  {
+    uint8_t hours = fromBcd(hourReg & 0x1f) + 1;
+    bool pm = hourReg & PM_BIT;
+
+    if (hours == 12)
+      pm = !pm;
+    else if (hours == 13)
+      hours = 1;
+
+    newDay = hours == 12 && !pm;
+    registers[REG_HOURS] = HOUR_12_BIT | (pm ? PM_BIT : 0) | toBcd(hours);
+  }
+  else
+  {
+    uint8_t hours = (fromBcd(hourReg & 0x3f) + 1) % 24;
+
+    newDay = hours == 0;
+    registers[REG_HOURS] = toBcd(hours);
+  }
+
+  if (!newDay)
+    return;
+
+  uint8_t month = fromBcd(registers[REG_MONTH]);
+  uint8_t year = fromBcd(registers[REG_YEAR]);
+  uint8_t date = fromBcd(registers[REG_DATE]) + 1;
+
+  registers[REG_DAY] = registers[REG_DAY] % 7 + 1;
+
+  if (date > daysInMonth(month, year))
+  {
+    date = 1;
+
+    if (++month > 12)
+    {
+      month = 1;
+      year = (year + 1) % 100;
+    }
+  }
+
+  registers[REG_DATE] = toBcd(date);
+  registers[REG_MONTH] = toBcd(month);
+  registers[REG_YEAR] = toBcd(year);
+}
+
+void SimDS1307::updateSqw()
+{
+  uint8_t control = registers[REG_CONTROL];
+  bool low;
+
+  if (control & CONTROL_SQWE)
+    low = (control & CONTROL_RS) == 0 && isRunning() && sqwLow;
+  else
+    low = !(control & CONTROL_OUT);
+
+  if (low && !pinLow && (hostReadRegister(REG_PCMSK2) & _BV(sqwPin)))
+  {
+    ticks++;
+    lastTickMicros = Board.now();
+  }
+
+  pinLow = low;
+  Board.driveInput(sqwPin, low, LOW);
+}
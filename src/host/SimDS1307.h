@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef SIMDS1307_H_
+#define SIMDS1307_H_
+
+#include "Host.h"
+
+#define SIM_DS1307_REGISTERS 64
+
+/**
+ * Simulated DS1307 on the host I2C bus. Keeps BCD time in its register file,
+ * honours the CH (clock halt) bit, 12/24 hour mode and calendar rollover, and
+ * drives the open drain SQW/OUT pin. Only the 1 Hz square wave is simulated;
+ * with any other rate selected the pin stays released.
+ *
+ * Like the real part, the seconds increment on the falling edge of the 1 Hz
+ * square wave and writing the seconds register restarts the countdown chain.
+ */
+class SimDS1307 : public HostDevice, public HostI2CDevice
+{
+  public:
+    SimDS1307(uint8_t);
+    void powerUp();
+    void setTime(uint8_t, uint8_t, uint8_t);
+    bool load(const char*);
+    bool save(const char*);
+    void setRegisters(const uint8_t*);
+    uint8_t getRegister(uint8_t);
+    uint32_t getTicks();
+    uint64_t getLastTickMicros();
+
+    uint64_t nextEventMicros();
+    void fireEvent(uint64_t);
+    bool receive(const uint8_t*, uint8_t);
+    uint8_t transmit(uint8_t*, uint8_t);
+
+  private:
+    uint8_t registers[SIM_DS1307_REGISTERS];
+    uint8_t pointer;
+    uint8_t sqwPin;
+    uint64_t nextEdgeMicros;
+    bool sqwLow;
+    bool pinLow;
+    uint32_t ticks; // Falling edges the pin change interrupt could see
+    uint64_t lastTickMicros;
+
+    bool isRunning();
+    void restartCountdown();
+    void tick();
+    void updateSqw();
+};
+
+#endif // SIMDS1307_H_
@@ -0,0 +1,850 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Runs the Bluenumi firmware against the simulated board: setup() once, then
+ * loop() until the requested amount of virtual time has passed. Each loop()
+ * iteration is charged a fixed amount of virtual time (--loop-us); RTC ticks
+ * and scripted button presses fire the PCINT2 ISR at their exact virtual
+ * times, including during delay().
+ *
+ * Button input can also come from a trace recorded on the clock (--replay),
+ * and the output trace can be checked against an earlier run (--expect).
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "Host.h"
+#include "SimDS1307.h"
+#include "Display.h"
+#include "DS1307RTC.h"
+#include "I2CBus.h"
+#include "EventQueue.h"
+#include "Scheduler.h"
+#include "SoftClock.h"
+#include "Settings.h"
+#include "AlarmSchedule.h"
+#include "LEDController.h"
+#include "IdleManager.h"
+#include "IsrProfiler.h"
+#include "InputRecorder.h"
+#include "Telemetry.h"
+
+#define HZ_PIN 4
+#define TIME_BTN_PIN 3
+#define ALRM_BTN_PIN 2
+
+void setup();
+void loop();
+
+/*******************************************************************************
+ *
+ * Scripted Inputs
+ *
+ ******************************************************************************/
+
+struct InputEvent
+{
+  uint64_t micros;
+  uint8_t pin;
+  bool pressed;
+
+  bool operator<(const InputEvent &other) const { return micros < other.micros; }
+};
+
+/**
+ * Presses and releases buttons at scheduled virtual times. A pressed button
+ * pulls its pin low; a released one lets the pull-up win.
+ */
+class ButtonScript : public HostDevice
+{
+  public:
+    ButtonScript() : index(0) {}
+
+    void press(uint8_t pin, uint64_t at, uint64_t hold)
+    {
+      InputEvent down = {at, pin, true};
+      InputEvent up = {at + hold, pin, false};
+      events.push_back(down);
+      events.push_back(up);
+      std::stable_sort(events.begin(), events.end());
+    }
+
+    uint64_t nextEventMicros()
+    {
+      return index < events.size() ? events[index].micros : HOST_NEVER;
+    }
+
+    void fireEvent(uint64_t now)
+    {
+      const InputEvent &event = events[index++];
+      Board.driveInput(event.pin, event.pressed, LOW);
+    }
+
+  private:
+    std::vector<InputEvent> events;
+    size_t index;
+};
+
+/**
+ * Makes the DS1307 hang holding SDA low at scheduled virtual times, until it
+ * has been clocked the given number of times.
+ */
+class BusStallScript : public HostDevice
+{
+  public:
+    BusStallScript() : index(0) {}
+
+    void stall(uint64_t at, uint8_t clocks)
+    {
+      InputEvent event = {at, clocks, true};
+      events.push_back(event);
+      std::stable_sort(events.begin(), events.end());
+    }
+
+    uint64_t nextEventMicros()
+    {
+      return index < events.size() ? events[index].micros : HOST_NEVER;
+    }
+
+    void fireEvent(uint64_t now)
+    {
+      Board.stallI2C(events[index++].pin);
+    }
+
+  private:
+    std::vector<InputEvent> events;
+    size_t index;
+};
+
+/**
+ * Sends a file to the serial port at 9600 baud, one byte every ten bit
+ * times, starting at a scheduled virtual time.
+ */
+class SerialScript : public HostDevice
+{
+  public:
+    SerialScript() : index(0), startMicros(0) {}
+
+    bool load(const char *path, uint64_t at)
+    {
+      FILE *file = fopen(path, "rb");
+
+      if (!file)
+        return false;
+
+      int c;
+
+      while ((c = fgetc(file)) != EOF)
+        bytes.push_back(c);
+
+      fclose(file);
+      startMicros = at;
+
+      return true;
+    }
+
+    uint64_t nextEventMicros()
+    {
+      return index < bytes.size() ? startMicros + index * 10000000ULL / 9600 : HOST_NEVER;
+    }
+
+    void fireEvent(uint64_t now)
+    {
+      Board.receiveSerial(bytes[index++]);
+    }
+
+  private:
+    std::vector<uint8_t> bytes;
+    size_t index;
+    uint64_t startMicros;
+};
+
+/**
+ * Plays back a trace printed by InputRecorder: the DS1307 starts with the
+ * registers the firmware found at power-up, and the button pins follow the
+ * recorded transitions. Each transition is timed from the simulated square
+ * wave tick it was recorded against, or from the transition before it, so
+ * it lands on the same side of every tick as on the clock.
+ */
+class TraceReplay : public HostDevice
+{
+  public:
+    TraceReplay(SimDS1307 *rtc) : rtc(rtc), pinMask(0), dropped(0), index(0),
+        lastSecond(0), lastMicros(0), outOfStep(0) {}
+
+    bool load(const char *path)
+    {
+      FILE *file = fopen(path, "r");
+
+      if (!file)
+        return false;
+
+      char line[256];
+      bool header = false;
+      bool end = false;
+
+      while (!end && fgets(line, sizeof(line), file))
+      {
+        unsigned int second, offset, pins;
+
+        // Anything before the header is whatever else was on the port
+        if (!header)
+          header = strncmp(line, "BLUENUMI TRACE", 14) == 0;
+        else if (line[0] == 'R')
+          parseRegisters(line + 1);
+        else if (line[0] == 'M')
+          pinMask = strtoul(line + 1, NULL, 16);
+        else if (line[0] == 'D')
+          dropped = strtoul(line + 1, NULL, 10);
+        else if (strncmp(line, "END", 3) == 0)
+          end = true;
+        else if (sscanf(line, "%u %u %x", &second, &offset, &pins) == 3)
+        {
+          InputTransition transition = {(uint16_t) second, (uint16_t) offset, (uint8_t) pins};
+          transitions.push_back(transition);
+        }
+      }
+
+      fclose(file);
+
+      return header;
+    }
+
+    /**
+     * Puts the DS1307 in its recorded state. Called once the command line
+     * has been read, so that it wins over --rtc and --nvram.
+     */
+    void start()
+    {
+      rtc->setRegisters(registers);
+    }
+
+    uint16_t getDropped() { return dropped; }
+    size_t getCount() { return transitions.size(); }
+    size_t getPlayed() { return index; }
+    uint32_t getOutOfStep() { return outOfStep; }
+
+    uint64_t nextEventMicros()
+    {
+      if (index >= transitions.size())
+        return HOST_NEVER;
+
+      const InputTransition &transition = transitions[index];
+      uint64_t base = lastMicros;
+
+      // A tick came in between, so the offset is from that tick
+      if (transition.second != lastSecond)
+      {
+        uint32_t ticks = rtc->getTicks();
+
+        if (ticks < transition.second)
+          return HOST_NEVER;
+
+        base = ticks == transition.second ? rtc->getLastTickMicros() : Board.now();
+      }
+
+      return max(base + transition.offset * 1000ULL, Board.now());
+    }
+
+    void fireEvent(uint64_t now)
+    {
+      const InputTransition &transition = transitions[index++];
+
+      // The firmware saw more ticks than the clock did by this point
+      if (rtc->getTicks() != transition.second)
+        outOfStep++;
+
+      for (uint8_t pin = 0; pin < 8; pin++)
+      {
+        if (pinMask & _BV(pin))
+          Board.driveInput(pin, !(transition.pins & _BV(pin)), LOW);
+      }
+
+      lastSecond = transition.second;
+      lastMicros = now;
+    }
+
+  private:
+    SimDS1307 *rtc;
+    uint8_t registers[SIM_DS1307_REGISTERS];
+    uint8_t pinMask;
+    uint16_t dropped;
+    std::vector<InputTransition> transitions;
+    size_t index;
+    uint16_t lastSecond;
+    uint64_t lastMicros;
+    uint32_t outOfStep;
+
+    void parseRegisters(const char *hex)
+    {
+      memset(registers, 0, sizeof(registers));
+
+      for (uint8_t i = 0; i < SIM_DS1307_REGISTERS; i++)
+      {
+        unsigned int value;
+
+        if (sscanf(hex + 1 + 2*i, "%2x", &value) != 1)
+          break;
+
+        registers[i] = value;
+      }
+    }
+};
+
+/**
+ * Samples the underlights once a virtual second for the trace, so a replay
+ * also compares the LED animation.
+ */
+class LEDSampler : public HostDevice
+{
+  public:
+    LEDSampler() : nextMicros(HOST_NEVER) {}
+
+    void start() { nextMicros = 0; }
+
+    uint64_t nextEventMicros()
+    {
+      return nextMicros;
+    }
+
+    void fireEvent(uint64_t now);
+
+  private:
+    uint64_t nextMicros;
+};
+
+/*******************************************************************************
+ *
+ * Output Tracing
+ *
+ ******************************************************************************/
+
+static const struct { uint8_t segments; char c; } glyphs[] = {
+  {0b01111011, '0'}, {0b01100000, '1'}, {0b01010111, '2'}, {0b01110110, '3'},
+  {0b01101100, '4'}, {0b00111110, '5'}, {0b00111111, '6'}, {0b01110000, '7'},
+  {0b01111111, '8'}, {0b01111110, '9'},
+  {SegmentDisplay::A, 'A'}, {SegmentDisplay::P, 'P'}, {SegmentDisplay::H, 'H'},
+  {SegmentDisplay::R, 'R'}, {SegmentDisplay::M, 'M'}, {SegmentDisplay::DASH, '-'},
+  {0, ' '}
+};
+
+static char decodeGlyph(uint8_t segments)
+{
+  for (size_t i = 0; i < sizeof(glyphs) / sizeof(glyphs[0]); i++)
+  {
+    if (glyphs[i].segments == segments)
+      return glyphs[i].c;
+  }
+
+  return '?';
+}
+
+/**
+ * Renders what a person looking at the clock would see, e.g. "12:34 pm".
+ * Dimmed tubes show their brightness as a fraction of full.
+ */
+static void describeOutputs(char *buffer, size_t size)
+{
+  uint32_t frame = Board.getFrame();
+  unsigned int level = Board.getTubeBrightness() * DISPLAY_BRIGHTNESS_LEVELS + 0.5;
+  char digits[5];
+  char dim[16] = "";
+
+  for (uint8_t i = 0; i < 4; i++)
+    digits[i] = Board.getTubesLit() ? decodeGlyph(frame >> (24 - 8*i)) : ' ';
+
+  digits[4] = '\0';
+
+  if (Board.getTubesLit() && level < DISPLAY_BRIGHTNESS_LEVELS)
+    snprintf(dim, sizeof(dim), " dim=%u/%u", level, DISPLAY_BRIGHTNESS_LEVELS);
+
+  snprintf(buffer, size, "%c%c:%c%c %s %s tone=%u%s",
+      digits[0], digits[1], digits[2], digits[3],
+      Board.readPin(HOST_AMPM_PIN) ? "PM" : "--",
+      Board.readPin(HOST_ALRM_PIN) ? "AL" : "--",
+      Board.getToneFrequency(), dim);
+}
+
+static void formatMicros(char *buffer, size_t size, uint64_t micros)
+{
+  uint64_t ms = micros / 1000;
+
+  snprintf(buffer, size, "%3llud %02llu:%02llu:%02llu.%03llu",
+      (unsigned long long) (ms / 86400000),
+      (unsigned long long) (ms / 3600000 % 24),
+      (unsigned long long) (ms / 60000 % 60),
+      (unsigned long long) (ms / 1000 % 60),
+      (unsigned long long) (ms % 1000));
+}
+
+static bool printTrace = false;
+static bool keepTrace = false;
+static std::vector<std::string> traceLines;
+
+/**
+ * Prints a trace line with the current virtual time, and keeps it for
+ * --expect.
+ */
+static void emitTrace(const char *text)
+{
+  char stamp[32];
+  char line[128];
+
+  formatMicros(stamp, sizeof(stamp), Board.now());
+  snprintf(line, sizeof(line), "[%s] %s", stamp, text);
+
+  if (printTrace)
+    printf("%s\n", line);
+
+  if (keepTrace)
+    traceLines.push_back(line);
+}
+
+static void traceOutputs()
+{
+  static char last[64];
+  char current[64];
+
+  describeOutputs(current, sizeof(current));
+
+  if (strcmp(current, last) == 0)
+    return;
+
+  strcpy(last, current);
+  emitTrace(current);
+}
+
+void LEDSampler::fireEvent(uint64_t now)
+{
+  static char last[64];
+  char current[64];
+
+  snprintf(current, sizeof(current), "leds %.1f %.1f %.1f %.1f",
+      Board.getBrightness(SECONDS0_PIN) * 100, Board.getBrightness(SECONDS1_PIN) * 100,
+      Board.getBrightness(SECONDS2_PIN) * 100, Board.getBrightness(SECONDS3_PIN) * 100);
+
+  if (strcmp(current, last) != 0)
+  {
+    strcpy(last, current);
+    emitTrace(current);
+  }
+
+  nextMicros = now + 1000000;
+}
+
+/**
+ * Compares the trace lines of this run with those in path, ignoring any
+ * other lines there. Returns the number of the first line that differs,
+ * counting from 1, or 0 if none does.
+ */
+static size_t compareTrace(const char *path, std::string *expected)
+{
+  FILE *file = fopen(path, "r");
+  char line[256];
+  size_t count = 0;
+
+  if (!file)
+    return 1;
+
+  while (fgets(line, sizeof(line), file))
+  {
+    if (line[0] != '[')
+      continue;
+
+    line[strcspn(line, "\r\n")] = '\0';
+
+    if (count >= traceLines.size() || traceLines[count] != line)
+    {
+      *expected = line;
+      fclose(file);
+      return count + 1;
+    }
+
+    count++;
+  }
+
+  fclose(file);
+
+  if (count < traceLines.size())
+  {
+    *expected = "(end of file)";
+    return count + 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ *
+ * Command Line
+ *
+ ******************************************************************************/
+
+static uint64_t parseDuration(const char *str)
+{
+  char *end;
+  double val = strtod(str, &end);
+
+  switch (*end)
+  {
+    case 'd': return val * 86400e6;
+    case 'h': return val * 3600e6;
+    case 'm': return val * 60e6;
+    case 's': return val * 1e6;
+    default: return val * 1e3;
+  }
+}
+
+static uint8_t parseButton(const char *name, size_t length)
+{
+  if (strncmp(name, "time", length) == 0)
+    return TIME_BTN_PIN;
+
+  if (strncmp(name, "alarm", length) == 0)
+    return ALRM_BTN_PIN;
+
+  return 0xFF;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+      "Usage: %s [options]\n"
+      "  --run DURATION      virtual time to simulate (default 1d)\n"
+      "  --rtc HH:MM[:SS]    start the RTC running at a 24-hour time\n"
+      "  --nvram FILE        load/save DS1307 registers and RAM\n"
+      "  --loop-us N         virtual time charged per loop() (default 100)\n"
+      "  --speed X           run at most X times faster than real time\n"
+      "  --press BTN,AT,HOLD press time|alarm|both at AT for HOLD\n"
+      "  --i2c-stall AT[,N]  RTC holds SDA low at AT until clocked N times (default 9)\n"
+      "  --upload FILE[,AT]  send FILE to the serial port at AT (default 0)\n"
+      "  --trace             print every change of the visible outputs\n"
+      "  --trace-leds        add the underlights to the trace once a second\n"
+      "  --replay FILE       replay a trace printed by the input recorder\n"
+      "  --expect FILE       compare the trace with one saved from an earlier run\n"
+      "Durations are in ms unless suffixed with s, m, h or d.\n",
+      name);
+}
+
+int main(int argc, char **argv)
+{
+  static SimDS1307 rtc(HZ_PIN);
+  static ButtonScript buttons;
+  static BusStallScript stalls;
+  static SerialScript upload;
+  static TraceReplay replay(&rtc);
+  static LEDSampler leds;
+  uint64_t runMicros = 86400e6;
+  uint64_t loopMicros = 100;
+  const char *nvramPath = NULL;
+  const char *replayPath = NULL;
+  const char *expectPath = NULL;
+  bool traceLeds = false;
+
+  Board.attachI2CDevice(DS1307_I2C_ADDRESS, &rtc);
+  Board.attachDevice(&rtc);
+  Board.attachDevice(&buttons);
+  Board.attachDevice(&stalls);
+  Board.attachDevice(&upload);
+  Board.attachDevice(&replay);
+  Board.attachDevice(&leds);
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (strcmp(arg, "--trace") == 0)
+    {
+      printTrace = true;
+      continue;
+    }
+
+    if (strcmp(arg, "--trace-leds") == 0)
+    {
+      traceLeds = true;
+      continue;
+    }
+
+    if (!val)
+    {
+      usage(argv[0]);
+      return 1;
+    }
+
+    i++;
+
+    if (strcmp(arg, "--run") == 0)
+    {
+      runMicros = parseDuration(val);
+    }
+    else if (strcmp(arg, "--rtc") == 0)
+    {
+      unsigned int h = 0, m = 0, s = 0;
+      sscanf(val, "%u:%u:%u", &h, &m, &s);
+      rtc.setTime(h % 24, m % 60, s % 60);
+    }
+    else if (strcmp(arg, "--nvram") == 0)
+    {
+      nvramPath = val;
+      rtc.load(nvramPath);
+    }
+    else if (strcmp(arg, "--loop-us") == 0)
+    {
+      loopMicros = strtoull(val, NULL, 10);
+    }
+    else if (strcmp(arg, "--speed") == 0)
+    {
+      Board.setSpeed(strtod(val, NULL));
+    }
+    else if (strcmp(arg, "--press") == 0)
+    {
+      const char *at = strchr(val, ',');
+      const char *hold = at ? strchr(at + 1, ',') : NULL;
+      bool both = at && strncmp(val, "both", at - val) == 0;
+      uint8_t pin = at ? parseButton(val, at - val) : 0xFF;
+
+      if (!hold || (pin == 0xFF && !both))
+      {
+        usage(argv[0]);
+        return 1;
+      }
+
+      uint64_t atMicros = parseDuration(at + 1);
+      uint64_t holdMicros = parseDuration(hold + 1);
+
+      if (both)
+      {
+        buttons.press(TIME_BTN_PIN, atMicros, holdMicros);
+        buttons.press(ALRM_BTN_PIN, atMicros, holdMicros);
+      }
+      else
+      {
+        buttons.press(pin, atMicros, holdMicros);
+      }
+    }
+    else if (strcmp(arg, "--i2c-stall") == 0)
+    {
+      const char *clocks = strchr(val, ',');
+      stalls.stall(parseDuration(val), clocks ? atoi(clocks + 1) : 9);
+    }
+    else if (strcmp(arg, "--upload") == 0)
+    {
+      const char *at = strchr(val, ',');
+      std::string path(val, at ? at - val : strlen(val));
+
+      if (!upload.load(path.c_str(), at ? parseDuration(at + 1) : 0))
+      {
+        fprintf(stderr, "cannot read %s\n", path.c_str());
+        return 1;
+      }
+    }
+    else if (strcmp(arg, "--replay") == 0)
+    {
+      replayPath = val;
+
+      if (!replay.load(replayPath))
+      {
+        fprintf(stderr, "no trace in %s\n", replayPath);
+        return 1;
+      }
+    }
+    else if (strcmp(arg, "--expect") == 0)
+    {
+      expectPath = val;
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  keepTrace = expectPath != NULL;
+
+  if (printTrace || keepTrace)
+  {
+    Board.setOutputListener(&traceOutputs);
+
+    if (traceLeds)
+      leds.start();
+  }
+
+  if (replayPath)
+    replay.start();
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  // Apply inputs scheduled for power-up, such as a button held at boot
+  Board.advance(0);
+
+  // The Arduino core enables interrupts before calling setup()
+  sei();
+  setup();
+
+  while (Board.now() < runMicros)
+  {
+    loop();
+    Board.stats.loops++;
+    Board.advance(loopMicros);
+  }
+
+  gettimeofday(&end, NULL);
+
+  if (nvramPath)
+    rtc.save(nvramPath);
+
+  double wall = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  char stamp[32];
+  char outputs[64];
+  const HostStats &stats = Board.stats;
+
+  formatMicros(stamp, sizeof(stamp), Board.now());
+  describeOutputs(outputs, sizeof(outputs));
+
+  printf("virtual time      %s\n", stamp);
+  printf("wall time         %.3f s (%.0fx real time)\n", wall, Board.now() / 1e6 / wall);
+  printf("loop() calls      %llu\n", (unsigned long long) stats.loops);
+
+  const TelemetryData *telemetry = Telemetry.getData();
+
+  printf("loop run time     max %lu us;", (unsigned long) telemetry->maxLoop);
+
+  for (uint8_t i = 0; i < TELEMETRY_LOOP_BUCKETS; i++)
+  {
+    if (telemetry->loopHistogram[i] == 0)
+      continue;
+
+    if (i == 0)
+      printf(" <4 us %lu", (unsigned long) telemetry->loopHistogram[i]);
+    else
+      printf(", %lu+ us %lu", 2UL << i, (unsigned long) telemetry->loopHistogram[i]);
+  }
+
+  printf("\n");
+
+  static const char *const modeNames[NUM_RUN_MODES] =
+      { "RUN", "RUN_BLANK", "RUN_ALARM", "SET_TIME", "SET_ALARM" };
+
+  printf("mode handlers     max");
+
+  for (uint8_t i = 0; i < NUM_RUN_MODES; i++)
+    printf(" %s %u us%s", modeNames[i], telemetry->maxModeHandler[i],
+        i + 1 < NUM_RUN_MODES ? "," : "");
+
+  printf("\n");
+  printf("sleep             %.1f%% idle (%lu sleeps), %.1f%% power-down (%lu wakes)\n",
+      100.0 * stats.idleMicros / Board.now(), Idle.getSleeps(),
+      100.0 * stats.powerDownMicros / Board.now(), Idle.getPowerDowns());
+  printf("PCINT2 ISR calls  %llu\n", (unsigned long long) stats.isrCalls);
+  printf("TIMER0 ISR calls  %llu\n", (unsigned long long) stats.timerIsrCalls);
+  printf("TWI ISR calls     %llu\n", (unsigned long long) stats.twiIsrCalls);
+  printf("ISR events        max depth %u, %u overflows, max latency %lu us\n",
+      Events.getMaxDepth(), Events.getOverflows(), Events.getMaxLatency());
+
+  static const char *const isrNames[NUM_PROFILED_ISRS] =
+      { "PCINT2", "TIMER0_COMPA", "TIMER0_COMPB", "TWI" };
+
+  for (uint8_t i = 0; i < NUM_PROFILED_ISRS; i++)
+  {
+    IsrStats isr;
+    Profiler.getStats(i, &isr);
+    printf("ISR %-13s %lu entries, max %u cycles, mean %u, %u nested\n",
+        isrNames[i], isr.entries, isr.maxCycles, isr.meanCycles, isr.nested);
+  }
+
+  printf("pin change block  max %u cycles (bounds the wait)\n", Profiler.getMaxPinChangeBlock());
+  printf("digitalWrite      %llu\n", (unsigned long long) stats.pinWrites);
+  printf("analogWrite       %llu\n", (unsigned long long) stats.pwmWrites);
+  printf("595 clocks        %llu\n", (unsigned long long) stats.shiftClocks);
+  printf("595 latches       %llu\n", (unsigned long long) stats.latches);
+  printf("display frames    %lu requested, %lu pushed\n",
+      Display.getFramesRequested(), Display.getFramesPushed());
+  printf("LED frames        %lu drawn, %lu unchanged, %lu late, %lu missed, longest gap %lu ms\n",
+      LEDs.getFrames(), LEDs.getUnchangedFrames(), LEDs.getLateFrames(),
+      LEDs.getMissedFrames(), LEDs.getLongestGap());
+  printf("I2C transactions  %llu (%llu bytes, %llu errors)\n",
+      (unsigned long long) stats.i2cTransactions,
+      (unsigned long long) stats.i2cBytes,
+      (unsigned long long) stats.i2cErrors);
+  printf("I2C driver        %u errors, %u timeouts, %u bus recoveries\n",
+      I2C.getErrors(), I2C.getTimeouts(), I2C.getRecoveries());
+  printf("tones             %llu\n", (unsigned long long) stats.tones);
+  printf("serial received   %llu bytes (%llu dropped)\n",
+      (unsigned long long) stats.serialBytes,
+      (unsigned long long) stats.serialDropped);
+  printf("outputs           %s\n", outputs);
+  printf("underlights       %.3f%% %.3f%% %.3f%% %.3f%%\n",
+      Board.getBrightness(SECONDS0_PIN) * 100, Board.getBrightness(SECONDS1_PIN) * 100,
+      Board.getBrightness(SECONDS2_PIN) * 100, Board.getBrightness(SECONDS3_PIN) * 100);
+  printf("clock resyncs     %u (%u mismatched, last drift %d s)\n",
+      Clock.getResyncs(), Clock.getMismatches(), Clock.getLastDrift());
+  printf("settings          %u changes, %u writes\n",
+      Settings.getChanges(), Settings.getWrites());
+
+  if (Alarms.getNextFire() == NO_ALARM)
+    printf("next alarm        none (%u recomputes)\n", Alarms.getRecomputes());
+  else
+    printf("next alarm        slot %u, day %u %02u:%02u (%u recomputes)\n",
+        Alarms.getNextAlarm(), Alarms.getNextFire() / MINUTES_PER_DAY + 1,
+        Alarms.getNextFire() % MINUTES_PER_DAY / 60, Alarms.getNextFire() % 60,
+        Alarms.getRecomputes());
+
+  for (uint8_t i = 0; Tasks.getTask(i); i++)
+  {
+    const Task *task = Tasks.getTask(i);
+
+    printf("task %-13u%lu runs, %u overruns, max lateness %lu ms, max run %lu us\n",
+        i, task->runs, task->overruns, task->maxLateness, task->maxDuration);
+  }
+
+  if (replayPath)
+  {
+    printf("replay            %zu of %zu transitions, %u out of step, %u dropped by the recorder\n",
+        replay.getPlayed(), replay.getCount(), replay.getOutOfStep(), replay.getDropped());
+  }
+
+#if INPUT_TRACE
+  Recorder.dump();
+#endif
+
+  if (expectPath)
+  {
+    std::string expected;
+    size_t line = compareTrace(expectPath, &expected);
+
+    if (line)
+    {
+      printf("expect            differs at trace line %zu\n", line);
+      printf("  expected        %s\n", expected.c_str());
+      printf("  got             %s\n",
+          line <= traceLines.size() ? traceLines[line - 1].c_str() : "(end of trace)");
+      return 1;
+    }
+
+    printf("expect            %zu trace lines match\n", traceLines.size());
+  }
+
+  return 0;
+}
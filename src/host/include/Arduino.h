@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Host stand-in for the Arduino core. Only the parts of the core that the
+ * Bluenumi firmware uses are provided; everything is backed by the simulated
+ * board in Host.h.
+ *
+ * Note that unsigned long is 64 bits wide on the host, so unlike on the
+ * ATmega328P, millis() does not wrap after 49.7 days.
+ */
+
+#ifndef ARDUINO_H_
+#define ARDUINO_H_
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#define ARDUINO 100
+#define F_CPU 16000000UL
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define DEC 10
+#define HEX 16
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef unsigned int word;
+
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+void analogWrite(uint8_t, int);
+void shiftOut(uint8_t, uint8_t, uint8_t, uint8_t);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void delayMicroseconds(unsigned int);
+
+void tone(uint8_t, unsigned int, unsigned long duration = 0);
+void noTone(uint8_t);
+
+class HardwareSerial
+{
+  public:
+    void begin(unsigned long);
+    void end();
+    int available();
+    int read();
+    size_t write(uint8_t);
+    size_t write(const uint8_t*, size_t);
+    size_t print(const char*);
+    size_t print(char);
+    size_t print(long, int base = 10);
+    size_t print(unsigned long, int base = 10);
+    size_t print(int n, int base = 10) { return print((long) n, base); }
+    size_t print(unsigned int n, int base = 10) { return print((unsigned long) n, base); }
+    size_t print(unsigned char n, int base = 10) { return print((unsigned long) n, base); }
+    size_t print(double, int digits = 2);
+    size_t println();
+    template<typename T> size_t println(T val) { return print(val) + println(); }
+    template<typename T> size_t println(T val, int fmt) { return print(val, fmt) + println(); }
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // ARDUINO_H_
@@ -0,0 +1,37 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef AVR_INTERRUPT_H_
+#define AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+/**
+ * Interrupt vectors become plain C functions that the simulated board calls
+ * when the corresponding interrupt flag is raised and interrupts are enabled.
+ */
+#define ISR(vector, ...) extern "C" void vector(void)
+
+extern "C" void PCINT2_vect(void);
+extern "C" void TIMER0_COMPA_vect(void);
+extern "C" void TIMER0_COMPB_vect(void);
+extern "C" void TWI_vect(void);
+
+void sei();
+void cli();
+
+#endif // AVR_INTERRUPT_H_
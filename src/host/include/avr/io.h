@@ -0,0 +1,181 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Host stand-in for the ATmega328P I/O registers used by the firmware. Each
+ * register is a small proxy object so that reads and writes are routed
+ * through the simulated board, which lets port writes drive the simulated
+ * shift registers and pin change interrupts exactly like digitalWrite does.
+ */
+
+#ifndef AVR_IO_H_
+#define AVR_IO_H_
+
+#include <inttypes.h>
+
+#define _BV(bit) (1 << (bit))
+
+enum HostRegisterId
+{
+  REG_PINB = 0,
+  REG_DDRB,
+  REG_PORTB,
+  REG_PINC,
+  REG_DDRC,
+  REG_PORTC,
+  REG_PIND,
+  REG_DDRD,
+  REG_PORTD,
+  REG_PCICR,
+  REG_PCIFR,
+  REG_PCMSK0,
+  REG_PCMSK1,
+  REG_PCMSK2,
+  REG_SREG,
+  REG_TIMSK0,
+  REG_TIFR0,
+  REG_TCCR0A,
+  REG_TCCR1A,
+  REG_TCCR1B,
+  REG_TWBR,
+  REG_TWSR,
+  REG_TWDR,
+  REG_TWCR,
+  NUM_HOST_REGISTERS
+};
+
+// 16-bit timer registers, read and written whole
+enum HostRegister16Id
+{
+  REG_ICR1 = 0,
+  REG_OCR1A,
+  REG_OCR1B,
+  REG_TCNT1,
+  NUM_HOST_REGISTERS16
+};
+
+uint8_t hostReadRegister(uint8_t);
+void hostWriteRegister(uint8_t, uint8_t);
+uint16_t hostReadRegister16(uint8_t);
+void hostWriteRegister16(uint8_t, uint16_t);
+
+class HostRegister
+{
+  public:
+    constexpr HostRegister(uint8_t id) : id(id) {}
+    operator uint8_t() const { return hostReadRegister(id); }
+    HostRegister& operator=(uint8_t val) { hostWriteRegister(id, val); return *this; }
+    // Compound assignments take an int, like the promoted AVR expressions
+    HostRegister& operator|=(int val) { return *this = *this | val; }
+    HostRegister& operator&=(int val) { return *this = *this & val; }
+    HostRegister& operator^=(int val) { return *this = *this ^ val; }
+
+  private:
+    uint8_t id;
+};
+
+class HostRegister16
+{
+  public:
+    constexpr HostRegister16(uint8_t id) : id(id) {}
+    operator uint16_t() const { return hostReadRegister16(id); }
+    HostRegister16& operator=(uint16_t val) { hostWriteRegister16(id, val); return *this; }
+
+  private:
+    uint8_t id;
+};
+
+extern HostRegister PINB, DDRB, PORTB;
+extern HostRegister PINC, DDRC, PORTC;
+extern HostRegister PIND, DDRD, PORTD;
+extern HostRegister PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+extern HostRegister SREG;
+extern HostRegister TIMSK0, TIFR0, TCCR0A;
+extern HostRegister TCCR1A, TCCR1B;
+extern HostRegister16 ICR1, OCR1A, OCR1B, TCNT1;
+extern HostRegister TWBR, TWSR, TWDR, TWCR;
+
+// PCICR
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+
+// PCIFR
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+
+// PCMSK2
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+#define PCINT19 3
+#define PCINT20 4
+#define PCINT21 5
+#define PCINT22 6
+#define PCINT23 7
+
+// TIMSK0
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+
+// TIFR0
+#define TOV0 0
+#define OCF0A 1
+#define OCF0B 2
+
+// TCCR0A
+#define WGM00 0
+#define WGM01 1
+#define COM0B0 4
+#define COM0B1 5
+#define COM0A0 6
+#define COM0A1 7
+
+// TCCR1A
+#define WGM10 0
+#define WGM11 1
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+
+// TCCR1B
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+
+// TWSR
+#define TWPS0 0
+#define TWPS1 1
+
+// TWCR
+#define TWIE 0
+#define TWEN 2
+#define TWWC 3
+#define TWSTO 4
+#define TWSTA 5
+#define TWEA 6
+#define TWINT 7
+
+// SREG
+#define SREG_I 7
+
+#endif // AVR_IO_H_
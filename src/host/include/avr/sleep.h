@@ -0,0 +1,37 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Sleep modes for the simulated board. sleep_cpu() moves virtual time on to
+ * the next interrupt that would wake the MCU; see HostBoard::sleep().
+ */
+
+#ifndef AVR_SLEEP_H_
+#define AVR_SLEEP_H_
+
+#include <inttypes.h>
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_PWR_DOWN 2
+
+void set_sleep_mode(uint8_t);
+void sleep_enable();
+void sleep_disable();
+void sleep_cpu();
+void sleep_bod_disable();
+
+#endif // AVR_SLEEP_H_
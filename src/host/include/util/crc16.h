@@ -0,0 +1,44 @@
+/*******************************************************************************
+ * Copyright (C) 2011 Sean Voisen <http://sean.voisen.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * Host stand-in for avr-libc's CRC helpers, using the C equivalents given
+ * in the avr-libc documentation for the inline assembly versions.
+ */
+
+#ifndef UTIL_CRC16_H_
+#define UTIL_CRC16_H_
+
+#include <inttypes.h>
+
+// Dallas/Maxim CRC-8 (polynomial x^8 + x^5 + x^4 + 1), as used by 1-Wire
+static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
+{
+  crc = crc ^ data;
+
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    if (crc & 0x01)
+      crc = (crc >> 1) ^ 0x8C;
+    else
+      crc >>= 1;
+  }
+
+  return crc;
+}
+
+#endif // UTIL_CRC16_H_
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Turns an Arduino sketch into a plain C++ file the way the Arduino IDE does:
+# the core header is included first and a prototype for every function
+# defined at file scope is inserted ahead of the first definition, so
+# functions can be used before they are defined.
+#
+# Usage: ino2cpp.sh <sketch.ino> <output.cpp>
+
+set -e
+
+SKETCH="$1"
+OUTPUT="$2"
+DEFINITION='^(static |inline )*[A-Za-z_][A-Za-z0-9_]*( [A-Za-z_][A-Za-z0-9_]*)?[ *&]+[A-Za-z_][A-Za-z0-9_]*[ ]*\([^;]*\)[ ]*$'
+
+awk -v def="$DEFINITION" -v sketch="$SKETCH" '
+  NR == FNR {
+    if ($0 ~ def)
+    {
+      if (!first)
+        first = FNR;
+      protos[count++] = $0 ";";
+    }
+    next;
+  }
+  FNR == 1 {
+    print "#include <Arduino.h>";
+    printf "#line 1 \"%s\"\n", sketch;
+  }
+  FNR == first {
+    for (i = 0; i < count; i++)
+      print protos[i];
+    printf "#line %d \"%s\"\n", FNR, sketch;
+  }
+  { print }
+' "$SKETCH" "$SKETCH" > "$OUTPUT"